@@ -54,7 +54,15 @@ _CheckError( const char* file, int line )
 
 //----------------------------------------------------------------------------
 
-#define CheckError()  _CheckError( __FILE__, __LINE__ )
+// Release builds (NDEBUG) don't check at all.  Debug builds stop polling once
+// a GL_KHR_debug callback reports errors as they happen (see debug-output.h).
+
+#ifdef NDEBUG
+#  define CheckError()  ((void) 0)
+#else
+extern bool glDebugOutputActive;
+#  define CheckError()  do { if ( !glDebugOutputActive ) _CheckError( __FILE__, __LINE__ ); } while (0)
+#endif
 
 //----------------------------------------------------------------------------
 
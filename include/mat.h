@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include "vec.h"
+#include "simd.h"
 
 namespace Angel {
 
@@ -35,12 +36,8 @@ class mat2 {
     mat2( GLfloat m00, GLfloat m10, GLfloat m01, GLfloat m11 )
 	{ _m[0] = vec2( m00, m01 ); _m[1] = vec2( m10, m11 ); }
 
-    mat2( const mat2& m ) {
-	if ( *this != m ) {
-	    _m[0] = m._m[0];
-	    _m[1] = m._m[1];
-	} 
-    }
+    mat2( const mat2& m )
+	{ _m[0] = m._m[0];  _m[1] = m._m[1]; }
 
     //
     //  --- Indexing Operator ---
@@ -214,13 +211,7 @@ class mat3 {
 	}
 
     mat3( const mat3& m )
-	{
-	    if ( *this != m ) {
-		_m[0] = m._m[0];
-		_m[1] = m._m[1];
-		_m[2] = m._m[2];
-	    } 
-	}
+	{ _m[0] = m._m[0];  _m[1] = m._m[1];  _m[2] = m._m[2]; }
 
     //
     //  --- Indexing Operator ---
@@ -403,14 +394,7 @@ class mat4 {
 	}
 
     mat4( const mat4& m )
-	{
-	    if ( *this != m ) {
-		_m[0] = m._m[0];
-		_m[1] = m._m[1];
-		_m[2] = m._m[2];
-		_m[3] = m._m[3];
-	    } 
-	}
+	{ _m[0] = m._m[0];  _m[1] = m._m[1];  _m[2] = m._m[2];  _m[3] = m._m[3]; }
 
     //
     //  --- Indexing Operator ---
@@ -449,16 +433,8 @@ class mat4 {
 	{ return m * s; }
 	
     mat4 operator * ( const mat4& m ) const {
-	mat4  a( 0.0 );
-
-	for ( int i = 0; i < 4; ++i ) {
-	    for ( int j = 0; j < 4; ++j ) {
-		for ( int k = 0; k < 4; ++k ) {
-		    a[i][j] += _m[i][k] * m[k][j];
-		}
-	    }
-	}
-
+	mat4  a;
+	simd::mat4Mul( *this, m, a );  // See simd.h
 	return a;
     }
 
@@ -482,17 +458,8 @@ class mat4 {
     }
 
     mat4& operator *= ( const mat4& m ) {
-	mat4  a( 0.0 );
-
-	for ( int i = 0; i < 4; ++i ) {
-	    for ( int j = 0; j < 4; ++j ) {
-		for ( int k = 0; k < 4; ++k ) {
-		    a[i][j] += _m[i][k] * m[k][j];
-		}
-	    }
-	}
-
-	return *this = a;
+	simd::mat4Mul( *this, m, *this );
+	return *this;
     }
 
     mat4& operator /= ( const GLfloat s ) {
@@ -513,11 +480,9 @@ class mat4 {
     //
 
     vec4 operator * ( const vec4& v ) const {  // m * v
-	return vec4( _m[0][0]*v.x + _m[0][1]*v.y + _m[0][2]*v.z + _m[0][3]*v.w,
-		     _m[1][0]*v.x + _m[1][1]*v.y + _m[1][2]*v.z + _m[1][3]*v.w,
-		     _m[2][0]*v.x + _m[2][1]*v.y + _m[2][2]*v.z + _m[2][3]*v.w,
-		     _m[3][0]*v.x + _m[3][1]*v.y + _m[3][2]*v.z + _m[3][3]*v.w
-	    );
+	vec4  r;
+	simd::mat4Vec( *this, v, r );
+	return r;
     }
 	
     //
@@ -561,10 +526,26 @@ mat4 matrixCompMult( const mat4& A, const mat4& B ) {
 
 inline
 mat4 transpose( const mat4& A ) {
-    return mat4( A[0][0], A[1][0], A[2][0], A[3][0],
-		 A[0][1], A[1][1], A[2][1], A[3][1],
-		 A[0][2], A[1][2], A[2][2], A[3][2],
-		 A[0][3], A[1][3], A[2][3], A[3][3] );
+    mat4  r;
+    simd::mat4Transpose( A, r );
+    return r;
+}
+
+//
+//  --- Batch transforms ---
+//
+//    out[i] = m * in[i] for n vectors or matrices, on two at a time where
+//    the CPU has AVX.  out may be in, but must not otherwise overlap it.
+//
+
+inline
+void transform( const mat4& m, const vec4* in, vec4* out, int n ) {
+    simd::transformVec4s( m, &in[0].x, &out[0].x, n );
+}
+
+inline
+void transform( const mat4& m, const mat4* in, mat4* out, int n ) {
+    simd::mat4MulBatch( m, in[0], out[0], n );
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -581,13 +562,7 @@ vec4 mvmult( const mat4& a, const vec4& b )
 {
     Error( "replace with vector matrix multiplcation operator" );
 
-    vec4 c;
-    int i, j;
-    for(i=0; i<4; i++) {
-	c[i] =0.0;
-	for(j=0;j<4;j++) c[i]+=a[i][j]*b[j];
-    }
-    return c;
+    return a * b;
 }
 
 //----------------------------------------------------------------------------
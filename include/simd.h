@@ -0,0 +1,303 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- simd.h ---
+//
+//   SSE kernels behind mat4's products and transpose, and batch versions
+//   that transform whole arrays, using AVX when the CPU has it.
+//
+//   The kernels work on the row-major GLfloat[16] a mat4 converts to (and
+//   the GLfloat[4] of a vec4), so the classes keep the layout that is
+//   passed to OpenGL and need no particular alignment.  Every kernel has a
+//   scalar reference version, which is used when SSE isn't available or
+//   ANGEL_NO_SIMD is defined, and which perf/perftest checks the others
+//   against.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ANGEL_SIMD_H__
+#define __ANGEL_SIMD_H__
+
+#if !defined(ANGEL_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+#  define ANGEL_SSE
+#  include <xmmintrin.h>
+#  if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define ANGEL_AVX_DISPATCH   // AVX batch kernels, chosen at run time
+#    include <immintrin.h>
+#  endif
+#endif
+
+namespace Angel {
+
+namespace simd {
+
+//----------------------------------------------------------------------------
+//
+//  --- Scalar reference kernels ---
+//
+//  c may be the same array as a or b.
+//
+
+inline
+void mat4MulScalar( const GLfloat* a, const GLfloat* b, GLfloat* c )
+{
+    GLfloat r[16];
+    for ( int i = 0; i < 4; ++i ) {
+	for ( int j = 0; j < 4; ++j ) {
+	    r[i*4+j] = 0.0;
+	    for ( int k = 0; k < 4; ++k ) {
+		r[i*4+j] += a[i*4+k] * b[k*4+j];
+	    }
+	}
+    }
+    for ( int i = 0; i < 16; ++i ) c[i] = r[i];
+}
+
+inline
+void mat4VecScalar( const GLfloat* m, const GLfloat* v, GLfloat* r )
+{
+    GLfloat t[4];
+    for ( int i = 0; i < 4; ++i )
+	t[i] = m[i*4]*v[0] + m[i*4+1]*v[1] + m[i*4+2]*v[2] + m[i*4+3]*v[3];
+    for ( int i = 0; i < 4; ++i ) r[i] = t[i];
+}
+
+inline
+void mat4TransposeScalar( const GLfloat* m, GLfloat* r )
+{
+    GLfloat t[16];
+    for ( int i = 0; i < 4; ++i )
+	for ( int j = 0; j < 4; ++j )
+	    t[j*4+i] = m[i*4+j];
+    for ( int i = 0; i < 16; ++i ) r[i] = t[i];
+}
+
+inline
+void transformVec4sScalar( const GLfloat* m, const GLfloat* in, GLfloat* out, int n )
+{
+    for ( int i = 0; i < n; ++i ) mat4VecScalar( m, in + i*4, out + i*4 );
+}
+
+inline
+void mat4MulBatchScalar( const GLfloat* a, const GLfloat* in, GLfloat* out, int n )
+{
+    for ( int i = 0; i < n; ++i ) mat4MulScalar( a, in + i*16, out + i*16 );
+}
+
+#ifdef ANGEL_SSE
+
+//----------------------------------------------------------------------------
+//
+//  --- SSE kernels ---
+//
+//  Row i of a*b is the sum of b's rows weighted by row i of a, so each row
+//  takes four broadcasts and four multiply-adds rather than sixteen dot
+//  products.
+//
+
+inline
+__m128 rowTimesMat4SSE( __m128 row, const __m128* b )
+{
+    __m128 r = _mm_mul_ps( _mm_shuffle_ps(row, row, _MM_SHUFFLE(0,0,0,0)), b[0] );
+    r = _mm_add_ps( r, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1,1,1,1)), b[1]) );
+    r = _mm_add_ps( r, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2,2,2,2)), b[2]) );
+    r = _mm_add_ps( r, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3,3,3,3)), b[3]) );
+    return r;
+}
+
+inline
+void mat4MulSSE( const GLfloat* a, const GLfloat* b, GLfloat* c )
+{
+    // All of b is read before anything is written, in case c is b.
+    __m128 rows[4] = { _mm_loadu_ps(b), _mm_loadu_ps(b+4), _mm_loadu_ps(b+8), _mm_loadu_ps(b+12) };
+    for ( int i = 0; i < 4; ++i )
+	_mm_storeu_ps( c + i*4, rowTimesMat4SSE(_mm_loadu_ps(a + i*4), rows) );
+}
+
+inline
+void mat4VecSSE( const GLfloat* m, const GLfloat* v, GLfloat* r )
+{
+    __m128 x = _mm_loadu_ps(v);
+    __m128 p0 = _mm_mul_ps( _mm_loadu_ps(m),    x );
+    __m128 p1 = _mm_mul_ps( _mm_loadu_ps(m+4),  x );
+    __m128 p2 = _mm_mul_ps( _mm_loadu_ps(m+8),  x );
+    __m128 p3 = _mm_mul_ps( _mm_loadu_ps(m+12), x );
+    _MM_TRANSPOSE4_PS( p0, p1, p2, p3 );  // Then adding the rows sums each product
+    _mm_storeu_ps( r, _mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)) );
+}
+
+inline
+void mat4TransposeSSE( const GLfloat* m, GLfloat* r )
+{
+    __m128 r0 = _mm_loadu_ps(m), r1 = _mm_loadu_ps(m+4), r2 = _mm_loadu_ps(m+8), r3 = _mm_loadu_ps(m+12);
+    _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+    _mm_storeu_ps( r, r0 );  _mm_storeu_ps( r+4, r1 );
+    _mm_storeu_ps( r+8, r2 );  _mm_storeu_ps( r+12, r3 );
+}
+
+// m*v is v's components weighting m's columns, so transpose m once and
+// each vector takes four broadcasts and four multiply-adds.
+inline
+void transformVec4sSSE( const GLfloat* m, const GLfloat* in, GLfloat* out, int n )
+{
+    __m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m+4), c2 = _mm_loadu_ps(m+8), c3 = _mm_loadu_ps(m+12);
+    _MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+    for ( int i = 0; i < n; ++i ) {
+	__m128 v = _mm_loadu_ps( in + i*4 );
+	__m128 r = _mm_mul_ps( _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,0,0,0)), c0 );
+	r = _mm_add_ps( r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1)), c1) );
+	r = _mm_add_ps( r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,2,2)), c2) );
+	r = _mm_add_ps( r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,3,3)), c3) );
+	_mm_storeu_ps( out + i*4, r );
+    }
+}
+
+inline
+void mat4MulBatchSSE( const GLfloat* a, const GLfloat* in, GLfloat* out, int n )
+{
+    for ( int i = 0; i < n; ++i ) mat4MulSSE( a, in + i*16, out + i*16 );
+}
+
+#endif // ANGEL_SSE
+
+#ifdef ANGEL_AVX_DISPATCH
+
+//----------------------------------------------------------------------------
+//
+//  --- AVX batch kernels ---
+//
+//  These work on two vectors, or two rows, per instruction.  They are
+//  compiled for AVX whatever the build flags, and only called after
+//  checking that the CPU has it.
+//
+
+__attribute__((target("avx"))) inline
+__m256 bothHalvesAVX( __m128 x )
+{
+    return _mm256_insertf128_ps( _mm256_castps128_ps256(x), x, 1 );
+}
+
+__attribute__((target("avx"))) inline
+void transformVec4sAVX( const GLfloat* m, const GLfloat* in, GLfloat* out, int n )
+{
+    __m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m+4), c2 = _mm_loadu_ps(m+8), c3 = _mm_loadu_ps(m+12);
+    _MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+    __m256 C0 = bothHalvesAVX(c0), C1 = bothHalvesAVX(c1), C2 = bothHalvesAVX(c2), C3 = bothHalvesAVX(c3);
+
+    int i = 0;
+    for ( ; i + 2 <= n; i += 2 ) {
+	__m256 v = _mm256_loadu_ps( in + i*4 );
+	__m256 r = _mm256_mul_ps( _mm256_permute_ps(v, _MM_SHUFFLE(0,0,0,0)), C0 );
+	r = _mm256_add_ps( r, _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(1,1,1,1)), C1) );
+	r = _mm256_add_ps( r, _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(2,2,2,2)), C2) );
+	r = _mm256_add_ps( r, _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(3,3,3,3)), C3) );
+	_mm256_storeu_ps( out + i*4, r );
+    }
+    if ( i < n ) transformVec4sSSE( m, in + i*4, out + i*4, n - i );
+}
+
+// Rows 2p and 2p+1 of a*b are b's rows weighted by rows 2p and 2p+1 of a,
+// so with each of b's rows in both halves of a register, a pair of rows
+// takes four multiply-adds.
+__attribute__((target("avx"))) inline
+void mat4MulBatchAVX( const GLfloat* a, const GLfloat* in, GLfloat* out, int n )
+{
+    __m256 weights[2][4];
+    for ( int p = 0; p < 2; ++p )
+	for ( int k = 0; k < 4; ++k )
+	    weights[p][k] = _mm256_insertf128_ps( _mm256_castps128_ps256(_mm_set1_ps(a[2*p*4 + k])),
+						  _mm_set1_ps(a[(2*p+1)*4 + k]), 1 );
+
+    for ( int i = 0; i < n; ++i ) {
+	const GLfloat* b = in + i*16;
+	__m256 b0 = _mm256_broadcast_ps( (const __m128*) b );
+	__m256 b1 = _mm256_broadcast_ps( (const __m128*) (b+4) );
+	__m256 b2 = _mm256_broadcast_ps( (const __m128*) (b+8) );
+	__m256 b3 = _mm256_broadcast_ps( (const __m128*) (b+12) );
+	for ( int p = 0; p < 2; ++p ) {
+	    __m256 r = _mm256_mul_ps( weights[p][0], b0 );
+	    r = _mm256_add_ps( r, _mm256_mul_ps(weights[p][1], b1) );
+	    r = _mm256_add_ps( r, _mm256_mul_ps(weights[p][2], b2) );
+	    r = _mm256_add_ps( r, _mm256_mul_ps(weights[p][3], b3) );
+	    _mm256_storeu_ps( out + i*16 + p*8, r );
+	}
+    }
+}
+
+inline
+bool cpuHasAVX()
+{
+    static const bool hasAVX = ( __builtin_cpu_init(), __builtin_cpu_supports("avx") );
+    return hasAVX;
+}
+
+#endif // ANGEL_AVX_DISPATCH
+
+//----------------------------------------------------------------------------
+//
+//  --- The kernels mat.h uses ---
+//
+
+inline
+void mat4Mul( const GLfloat* a, const GLfloat* b, GLfloat* c )
+{
+#ifdef ANGEL_SSE
+    mat4MulSSE( a, b, c );
+#else
+    mat4MulScalar( a, b, c );
+#endif
+}
+
+inline
+void mat4Vec( const GLfloat* m, const GLfloat* v, GLfloat* r )
+{
+#ifdef ANGEL_SSE
+    mat4VecSSE( m, v, r );
+#else
+    mat4VecScalar( m, v, r );
+#endif
+}
+
+inline
+void mat4Transpose( const GLfloat* m, GLfloat* r )
+{
+#ifdef ANGEL_SSE
+    mat4TransposeSSE( m, r );
+#else
+    mat4TransposeScalar( m, r );
+#endif
+}
+
+//  The batch kernels may write over their input (out == in), but out must
+//  not otherwise overlap it.
+
+inline
+void transformVec4s( const GLfloat* m, const GLfloat* in, GLfloat* out, int n )
+{
+#if defined(ANGEL_AVX_DISPATCH)
+    if ( cpuHasAVX() ) transformVec4sAVX( m, in, out, n );
+    else transformVec4sSSE( m, in, out, n );
+#elif defined(ANGEL_SSE)
+    transformVec4sSSE( m, in, out, n );
+#else
+    transformVec4sScalar( m, in, out, n );
+#endif
+}
+
+inline
+void mat4MulBatch( const GLfloat* a, const GLfloat* in, GLfloat* out, int n )
+{
+#if defined(ANGEL_AVX_DISPATCH)
+    if ( cpuHasAVX() ) mat4MulBatchAVX( a, in, out, n );
+    else mat4MulBatchSSE( a, in, out, n );
+#elif defined(ANGEL_SSE)
+    mat4MulBatchSSE( a, in, out, n );
+#else
+    mat4MulBatchScalar( a, in, out, n );
+#endif
+}
+
+}  // namespace simd
+
+}  // namespace Angel
+
+#endif // __ANGEL_SIMD_H__
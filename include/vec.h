@@ -430,7 +430,7 @@ struct vec4 {
 
 inline
 GLfloat dot( const vec4& u, const vec4& v ) {
-    return u.x*v.x + u.y*v.y + u.z*v.z + u.w+v.w;
+    return u.x*v.x + u.y*v.y + u.z*v.z + u.w*v.w;
 }
 
 inline
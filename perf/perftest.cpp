@@ -0,0 +1,767 @@
+// ------ Microbenchmarks ---------------------------------------------------------
+//
+// Times the CPU-side kernels that the frame and the loading path lean on, using
+// the same code as scene-start (gnatidread.h, gnatidread2.h and Angel):
+//
+//     calculateAnimPose on the animated models 56 and 57, and the compiled
+//     skeleton's calculateSkeletonPose, after checking that they agree
+//     calculateSkeletonPose on compressed clips (clip-compress.h), with each
+//     clip's size before and after and the error against calculateAnimPose
+//     calculatePoses (pose-cache.h) on a crowd of instances, on one thread and
+//     on all of them, after checking that the two agree
+//     CPU skinning (cpu-skin.h): the scalar kernel, the SSE one on one thread
+//     and on all of them, in vertices per second, after checking they agree
+//     getBonesAffectingEachVertex on those and on the largest mesh
+//     getFaceIndices, the index copy in loadMeshIfNotAlreadyLoaded
+//     LoadDIBitmap on the largest texture
+//     mat4 multiply, and the Translate/Rotate/Scale chain from drawMesh
+//     the batch transforms of arrays of vec4s and mat4s (mat.h)
+//     the scene store (scene-store.h): a sweep over 100,000 objects' placements,
+//     and deleting and adding objects among them
+//
+// Before timing anything, the SIMD kernels in include/simd.h are checked
+// against their scalar reference versions, the animated models' clip bounds
+// (skeleton.h) against their vertices skinned as the shader does, at poses
+// between the samples, and the scene store's handles against deletions; a
+// mismatch fails the run.
+//
+// Each benchmark runs a few warmup repetitions, which also choose how many
+// iterations make a repetition of at least repMs, then takes the median of the
+// measured repetitions.  Results are compared with a baseline written earlier
+// by --save; a benchmark slower than the baseline by more than the threshold
+// is flagged and makes the exit status 1.
+//
+// Run from the top directory (so assets/ is found), normally via 'make perftest':
+//
+//     bin/perftest [--baseline FILE] [--save FILE] [--threshold PERCENT]
+//                  [--reps N] [--filter TEXT]
+
+#include "Angel.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "clip-compress.h"
+#include "cpu-skin.h"
+#include "frame-pacer.h"
+#include "jobs.h"
+#include "pose-cache.h"
+#include "scene-store.h"
+#include "skeleton.h"
+#include "trace.h"
+
+// gnatidread.h's mouse tools refer to these.
+GLint windowHeight=640, windowWidth=960;
+
+#include "gnatidread.h"
+#include "gnatidread2.h"
+
+using namespace std;
+
+const int warmupReps = 3;
+const double repMs = 20.0;  // Minimum length of a repetition, so the clock's resolution doesn't matter
+
+static int measuredReps = 15;
+static const char* filter = NULL;
+
+// Written by the benchmarks so their results can't be optimised away.
+volatile float sink;
+
+typedef struct {
+    string name;
+    double nsPerOp;   // Median over the measured repetitions
+    double minNs;
+    long itersPerRep;
+} BenchResult;
+
+static vector<BenchResult> results;
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Time body(), which performs one operation per call.
+template <typename Body>
+static void runBench(const char* name, Body body) {
+    if (filter != NULL && strstr(name, filter) == NULL) return;
+
+    // Warm up, doubling the iterations until a repetition is long enough.
+    long iters = 1;
+    for (int rep = 0; rep < warmupReps; rep++) {
+        for (;;) {
+            double start = nowNs();
+            for (long i = 0; i < iters; i++) body();
+            if (nowNs() - start >= repMs * 1e6) break;
+            iters *= 2;
+        }
+    }
+
+    vector<double> perOp;
+    for (int rep = 0; rep < measuredReps; rep++) {
+        double start = nowNs();
+        for (long i = 0; i < iters; i++) body();
+        perOp.push_back((nowNs() - start) / iters);
+    }
+    sort(perOp.begin(), perOp.end());
+
+    BenchResult r;
+    r.name = name;
+    r.nsPerOp = perOp[perOp.size() / 2];
+    r.minNs = perOp[0];
+    r.itersPerRep = iters;
+    results.push_back(r);
+    printf("%-44s %12.1f ns/op  (min %.1f, %ld per rep)\n", name, r.nsPerOp, r.minNs, iters);
+    fflush(stdout);
+}
+
+// Largest difference relative to the size of the values.
+static float relativeError(const GLfloat* got, const GLfloat* want, int n) {
+    float worst = 0.0;
+    for (int i = 0; i < n; i++)
+        worst = max(worst, fabsf(got[i] - want[i]) / max(1.0f, fabsf(want[i])));
+    return worst;
+}
+
+// ------ The benchmarks ---------------------------------------------------------
+
+static void benchAnimPose(int meshNumber) {
+    const aiScene* scene = loadScene(meshNumber);
+    if (scene == NULL || scene->mNumAnimations == 0) failInt("No animation in model", meshNumber);
+    aiMesh* mesh = scene->mMeshes[0];
+
+    // Step through the animation as drawMesh does, rather than repeating one pose.
+    vector<mat4> boneTransforms(max(mesh->mNumBones, 1u));
+    float duration = scene->mAnimations[0]->mDuration;
+    float poseTime = 0.0;
+
+    char name[64];
+    snprintf(name, sizeof name, "calculateAnimPose/model%d (%d bones)", meshNumber, mesh->mNumBones);
+    runBench(name, [&]{
+        calculateAnimPose(mesh, scene, 0, poseTime, &boneTransforms[0]);
+        poseTime += 0.37;
+        if (poseTime > duration) poseTime -= duration;
+        sink = boneTransforms[0][0][3];
+    });
+
+    // The same poses from the compiled skeleton, which should agree: every half
+    // tick up to where the app wraps pose times (see poseTimeFor in
+    // scene-start.cpp), which takes in the time after the last key.
+    Skeleton* skeleton = compileSkeleton(scene, mesh);
+    vector<mat4> skeletonTransforms(boneTransforms.size());
+    PoseScratch scratch;
+    float worst = 0.0;
+    for (int halfTicks = 0; halfTicks < 2 * 50; halfTicks++) {
+        float t = halfTicks / 2.0f;
+        calculateAnimPose(mesh, scene, 0, t, &boneTransforms[0]);
+        calculateSkeletonPose(skeleton, 0, t, &scratch, &skeletonTransforms[0]);
+        for (size_t b = 0; b < boneTransforms.size(); b++)
+            worst = max(worst, relativeError((GLfloat*) skeletonTransforms[b], (GLfloat*) boneTransforms[b], 16));
+    }
+    if (worst > 1e-4) {
+        printf("calculateSkeletonPose differs from calculateAnimPose by %g on model%d\n", worst, meshNumber);
+        exit(1);
+    }
+
+    poseTime = 0.0;
+    snprintf(name, sizeof name, "calculateSkeletonPose/model%d", meshNumber);
+    runBench(name, [&]{
+        calculateSkeletonPose(skeleton, 0, poseTime, &scratch, &skeletonTransforms[0]);
+        poseTime += 0.37;
+        if (poseTime > duration) poseTime -= duration;
+        sink = skeletonTransforms[0][0][3];
+    });
+    delete skeleton;
+    aiReleaseImport(scene);
+}
+
+// What assimp keeps for an animation: the channels and their keys.
+static long animationBytes(const aiAnimation* anim) {
+    long bytes = sizeof(aiAnimation) + anim->mNumChannels * (sizeof(aiNodeAnim) + sizeof(aiNodeAnim*));
+    for (unsigned int c = 0; c < anim->mNumChannels; c++) {
+        const aiNodeAnim* ch = anim->mChannels[c];
+        bytes += (ch->mNumPositionKeys + ch->mNumScalingKeys) * sizeof(aiVectorKey) +
+                 ch->mNumRotationKeys * sizeof(aiQuatKey);
+    }
+    return bytes;
+}
+
+static void benchClipCompression(int meshNumber) {
+    const aiScene* scene = loadScene(meshNumber);
+    if (scene == NULL || scene->mNumAnimations == 0) failInt("No animation in model", meshNumber);
+    aiMesh* mesh = scene->mMeshes[0];
+    Skeleton* skeleton = compileSkeleton(scene, mesh);
+
+    vector<long> sampledBytes;
+    for (size_t a = 0; a < skeleton->clips.size(); a++)
+        sampledBytes.push_back(clipBytes(skeleton->clips[a]));
+    compressSkeleton(skeleton, defaultClipTolerance);
+
+    // Against the original keys, over the whole of each clip.
+    vector<mat4> want(max(mesh->mNumBones, 1u)), got(want.size());
+    PoseScratch scratch;
+    for (size_t a = 0; a < skeleton->clips.size(); a++) {
+        float duration = scene->mAnimations[a]->mDuration, worst = 0.0;
+        for (float t = 0.0; t < duration; t += duration / 97.0) {
+            calculateAnimPose(mesh, scene, a, t, &want[0]);
+            calculateSkeletonPose(skeleton, a, t, &scratch, &got[0]);
+            for (size_t b = 0; b < want.size(); b++)
+                worst = max(worst, relativeError((GLfloat*) got[b], (GLfloat*) want[b], 16));
+        }
+        printf("model%d clip %d: %ld bytes of keys, %ld sampled, %ld compressed (%.0f%% of keys kept), "
+               "error %g\n", meshNumber, (int) a, animationBytes(scene->mAnimations[a]), sampledBytes[a],
+               clipBytes(skeleton->clips[a]), 100.0 * keptKeyFraction(skeleton->clips[a]), worst);
+    }
+
+    float duration = scene->mAnimations[0]->mDuration, poseTime = 0.0;
+    char name[64];
+    snprintf(name, sizeof name, "calculateSkeletonPose/model%d compressed", meshNumber);
+    runBench(name, [&]{
+        calculateSkeletonPose(skeleton, 0, poseTime, &scratch, &got[0]);
+        poseTime += 0.37;
+        if (poseTime > duration) poseTime -= duration;
+        sink = got[0][0][3];
+    });
+    delete skeleton;
+    aiReleaseImport(scene);
+}
+
+// A crowd of instances of one model, each at its own point in the animation,
+// posed as the animation stage in display() does.  Runs serially until initJobs.
+static void benchPoseStage(int meshNumber, int numInstances, const char* threads,
+                           vector<mat4>* palettes) {
+    const aiScene* scene = loadScene(meshNumber);
+    if (scene == NULL || scene->mNumAnimations == 0) failInt("No animation in model", meshNumber);
+    Skeleton* skeleton = compileSkeleton(scene, scene->mMeshes[0]);
+    float duration = scene->mAnimations[0]->mDuration;
+
+    char name[64];
+    snprintf(name, sizeof name, "calculatePoses/%d x model%d (%s)", numInstances, meshNumber, threads);
+    float start = 0.0;
+    runBench(name, [&]{
+        beginPoseCacheFrame();
+        beginPoseCacheFrame(); // Twice, so nothing is copied from the last repetition
+        for (int i = 0; i < numInstances; i++)
+            requestPose(meshNumber, skeleton, 0, fmod(start + i * duration / numInstances, duration));
+        calculatePoses();
+        start += 0.37;
+        sink = posePalettes()[0][0][3];
+    });
+
+    beginPoseCacheFrame();
+    for (int i = 0; i < numInstances; i++)
+        requestPose(meshNumber, skeleton, 0, i * duration / numInstances);
+    calculatePoses();
+    palettes->assign(posePalettes(), posePalettes() + posePalettesSize());
+    delete skeleton;
+    aiReleaseImport(scene);
+}
+
+// The job threads are started here, so this must be the first parallelFor.
+static void benchPoseStageScaling(int meshNumber) {
+    const int numInstances = 256;
+    vector<mat4> serial, parallel;
+    benchPoseStage(meshNumber, numInstances, "1 thread", &serial);
+    initJobs();
+    char threads[32];
+    snprintf(threads, sizeof threads, "%d threads", numJobThreads());
+    benchPoseStage(meshNumber, numInstances, threads, &parallel);
+
+    if (serial.size() != parallel.size() ||
+        memcmp(&serial[0], &parallel[0], serial.size() * sizeof(mat4)) != 0) {
+        printf("calculatePoses on the job threads differs from serial posing on model%d\n", meshNumber);
+        exit(1);
+    }
+}
+
+// For the benchmark just run, unless --filter left it out.
+static void printVerticesPerSecond(const char* name, int numVertices) {
+    if (results.empty() || results.back().name != name || results.back().nsPerOp <= 0.0) return;
+    printf("%-44s %12.1f M vertices/s\n", "", numVertices / results.back().nsPerOp * 1e3);
+}
+
+// Check the SSE kernel against the scalar one, then time both and the threaded version.
+static void benchSkinningKernels(const char* label, const SkinSource& source, const vector<mat4>& palette) {
+    int n = source.rest.numVertices;
+    SkinnedVertices scalar, simd;
+    initSkinnedVertices(&scalar, n);
+    initSkinnedVertices(&simd, n);
+    skinVerticesScalar(source, &palette[0], 0, n, &scalar);
+    skinVertices(source, &palette[0], &simd);
+    float worst = 0.0;
+    for (int v = 0; v < n; v++) {
+        GLfloat want[6] = { scalar.x[v], scalar.y[v], scalar.z[v], scalar.nx[v], scalar.ny[v], scalar.nz[v] };
+        GLfloat got[6] = { simd.x[v], simd.y[v], simd.z[v], simd.nx[v], simd.ny[v], simd.nz[v] };
+        worst = max(worst, relativeError(got, want, 6));
+    }
+    if (worst > 1e-5) {
+        printf("skinVertices differs from skinVerticesScalar by %g on %s\n", worst, label);
+        exit(1);
+    }
+
+    char name[64];
+    snprintf(name, sizeof name, "skinVerticesScalar/%s (%d vertices)", label, n);
+    runBench(name, [&]{
+        skinVerticesScalar(source, &palette[0], 0, n, &scalar);
+        sink = scalar.x[0];
+    });
+    printVerticesPerSecond(name, n);
+
+    snprintf(name, sizeof name, "skinVerticesRange/%s", label);
+    runBench(name, [&]{
+        skinVerticesRange(source, &palette[0], 0, n, &simd);
+        sink = simd.x[0];
+    });
+    printVerticesPerSecond(name, n);
+
+    snprintf(name, sizeof name, "skinVertices/%s (%d threads)", label, numJobThreads());
+    runBench(name, [&]{
+        skinVertices(source, &palette[0], &simd);
+        sink = simd.x[0];
+    });
+    printVerticesPerSecond(name, n);
+}
+
+// After benchPoseStageScaling, which starts the job threads.
+static void benchSkinning(int meshNumber) {
+    const aiScene* scene = loadScene(meshNumber);
+    if (scene == NULL || scene->mNumAnimations == 0) failInt("No animation in model", meshNumber);
+    aiMesh* mesh = scene->mMeshes[0];
+    Skeleton* skeleton = compileSkeleton(scene, mesh);
+
+    // Start the IDs out of range, as uploadMesh's uninitialised arrays might
+    // be, so the check fails if any slot is left unset.
+    int n = mesh->mNumVertices;
+    vector<GLint> boneIDs(4 * n, -1);
+    vector<GLfloat> boneWeights(4 * n);
+    getBonesAffectingEachVertex(mesh, (GLint(*)[4]) &boneIDs[0], (GLfloat(*)[4]) &boneWeights[0]);
+    SkinSource source;
+    initSkinSource(&source, n, &mesh->mVertices[0].x, &mesh->mNormals[0].x,
+                   (GLint(*)[4]) &boneIDs[0], (GLfloat(*)[4]) &boneWeights[0]);
+
+    vector<mat4> palette(max(mesh->mNumBones, 1u));
+    PoseScratch scratch;
+    calculateSkeletonPose(skeleton, 0, scene->mAnimations[0]->mDuration * 0.37f, &scratch, &palette[0]);
+
+    char label[16];
+    snprintf(label, sizeof label, "model%d", meshNumber);
+    benchSkinningKernels(label, source, palette);
+
+    delete skeleton;
+    aiReleaseImport(scene);
+}
+
+// A mesh larger than any of the models, with four bones on every vertex.
+static void benchSyntheticSkinning(int numVertices, int numBones) {
+    srand(3);
+    vector<float> positions(3 * numVertices), normals(3 * numVertices);
+    for (int i = 0; i < 3 * numVertices; i++) {
+        positions[i] = rand() % 2000 / 10.0f - 100.0f;
+        normals[i] = rand() % 200 / 100.0f - 1.0f;
+    }
+    vector<GLint> boneIDs(4 * numVertices);
+    vector<GLfloat> boneWeights(4 * numVertices);
+    for (int v = 0; v < numVertices; v++)
+        for (int j = 0; j < 4; j++) {
+            boneIDs[4*v + j] = rand() % numBones;
+            boneWeights[4*v + j] = 0.25f;
+        }
+    SkinSource source;
+    initSkinSource(&source, numVertices, &positions[0], &normals[0],
+                   (GLint(*)[4]) &boneIDs[0], (GLfloat(*)[4]) &boneWeights[0]);
+
+    vector<mat4> palette(numBones);
+    for (int b = 0; b < numBones; b++)
+        palette[b] = Translate(b, 2.0, -b) * RotateY(b * 7.0) * RotateX(b * 3.0);
+
+    char label[32];
+    snprintf(label, sizeof label, "%dk synthetic", numVertices / 1000);
+    benchSkinningKernels(label, source, palette);
+}
+
+static void benchMeshData(int meshNumber) {
+    const aiScene* scene = loadScene(meshNumber);
+    if (scene == NULL) failInt("Couldn't load model", meshNumber);
+    aiMesh* mesh = scene->mMeshes[0];
+
+    char name[64];
+    vector<GLint> boneIDs(mesh->mNumVertices * 4);
+    vector<GLfloat> boneWeights(mesh->mNumVertices * 4);
+    snprintf(name, sizeof name, "getBonesAffectingEachVertex/model%d (%dv)", meshNumber, mesh->mNumVertices);
+    runBench(name, [&]{
+        getBonesAffectingEachVertex(mesh, (GLint(*)[4]) &boneIDs[0], (GLfloat(*)[4]) &boneWeights[0]);
+        sink = boneWeights[0];
+    });
+
+    vector<GLuint> elements(mesh->mNumFaces * 3);
+    snprintf(name, sizeof name, "getFaceIndices/model%d (%d faces)", meshNumber, mesh->mNumFaces);
+    runBench(name, [&]{
+        getFaceIndices(mesh, &elements[0]);
+        sink = elements[elements.size() / 2];
+    });
+    aiReleaseImport(scene);
+}
+
+static void benchLoadBitmap(int textureNumber) {
+    char fileName[220];
+    sprintf(fileName, "%s/texture%d.bmp", dataDir, textureNumber);
+
+    char name[64];
+    snprintf(name, sizeof name, "LoadDIBitmap/texture%d", textureNumber);
+    runBench(name, [&]{
+        BITMAPINFO* info;
+        GLubyte* rgb = LoadDIBitmap(fileName, &info);
+        if (rgb == NULL) fail("Error loading image: ", fileName);
+        sink = rgb[0];
+        free(rgb);
+        free(info);
+    });
+}
+
+static void benchAngel() {
+    mat4 a = RotateX(30.0) * Translate(1.0, 2.0, 3.0);
+    mat4 b = RotateY(45.0) * Scale(0.5, 0.5, 0.5);
+    runBench("mat4 * mat4", [&]{
+        a = a * b;
+        a[3] = vec4(0.0, 0.0, 0.0, 1.0);  // Keep the values bounded
+        sink = a[0][0];
+    });
+
+    vec4 v(1.0, 2.0, 3.0, 1.0);
+    runBench("mat4 * vec4", [&]{
+        v = b * v;
+        v.w = 1.0;
+        sink = v.x;
+    });
+
+    // The model matrix from drawMesh, then on to clip space.
+    mat4 view = Translate(0.0, 0.0, -20.0) * RotateX(10.0) * RotateY(30.0);
+    mat4 projection = Frustum(-0.2, 0.2, -0.15, 0.15, 0.2, 100.0);
+    vec3 loc(1.0, 0.0, 2.0);
+    float angles[3] = {90.0, 10.0, 20.0};
+    runBench("drawMesh model-view-projection", [&]{
+        mat4 model = Translate(loc);
+        model = model * RotateY(angles[1]);
+        model = model * RotateZ(angles[2]);
+        model = model * RotateX(angles[0]);
+        model = model * Scale(0.3);
+        mat4 mvp = projection * view * model;
+        angles[1] += 0.5;
+        sink = mvp[2][3];
+    });
+}
+
+static void benchAngelBatch() {
+    const int n = 4096;
+    mat4 m = RotateX(30.0) * Translate(1.0, 2.0, 3.0);
+    vector<vec4> points(n, vec4(1.0, 2.0, 3.0, 1.0)), transformed(n);
+    runBench("transform 4096 vec4", [&]{
+        transform(m, &points[0], &transformed[0], n);
+        sink = transformed[n-1].x;
+    });
+
+    vector<mat4> bones(256, RotateY(10.0)), posed(256);
+    runBench("transform 256 mat4", [&]{
+        transform(m, &bones[0], &posed[0], 256);
+        sink = posed[255][0][0];
+    });
+}
+
+static void benchSceneStore(int numObjects) {
+    SceneStore store = SceneStore();
+    vector<ObjectHandle> handles;
+    srand(1);
+    for (int i = 0; i < numObjects; i++) {
+        handles.push_back(addSceneObject(&store));
+        store.loc[i] = vec4(rand() % 2000 / 10.0f - 100.0f, 0.0, rand() % 2000 / 10.0f - 100.0f, 1.0);
+        store.scale[i] = 1.0 + i % 7;
+        store.hidden[i] = i % 16 == 0;
+    }
+
+    // What culling reads of each object before it knows whether it's visible.
+    char name[64];
+    snprintf(name, sizeof name, "scene store sweep (%d objects)", numObjects);
+    runBench(name, [&]{
+        float sum = 0.0;
+        for (int i = 0; i < store.count; i++)
+            if (!store.hidden[i])
+                sum += store.loc[i].x * store.scale[i];
+        sink = sum;
+    });
+
+    // Delete a random object and add one in its place, keeping the count.
+    runBench("scene store delete and add", [&]{
+        int h = rand() % handles.size();
+        removeSceneObject(&store, handles[h]);
+        handles[h] = addSceneObject(&store);
+        sink = store.count;
+    });
+}
+
+// ------ Checking the SIMD kernels ----------------------------------------------
+
+static float randomFloat() {
+    return rand() / (float) RAND_MAX * 200.0f - 100.0f;
+}
+
+static mat4 randomMat4() {
+    mat4 m;
+    for (int i = 0; i < 16; i++) ((GLfloat*) m)[i] = randomFloat();
+    return m;
+}
+
+// Returns the number of clips with a skinned vertex outside their bounds.
+static int checkClipBounds(int meshNumber) {
+    const aiScene* scene = loadScene(meshNumber);
+    aiMesh* mesh = scene->mMeshes[0];
+    Skeleton* skeleton = compileSkeleton(scene, mesh);
+
+    int n = mesh->mNumVertices;
+    vector<GLint> boneIDs(4 * n);
+    vector<GLfloat> boneWeights(4 * n);
+    getBonesAffectingEachVertex(mesh, (GLint(*)[4]) &boneIDs[0], (GLfloat(*)[4]) &boneWeights[0]);
+
+    vector<mat4> palette(max(mesh->mNumBones, 1u));
+    PoseScratch scratch;
+    int failures = 0;
+    for (size_t a = 0; a < skeleton->clips.size(); a++) {
+        const SkeletonClip& clip = skeleton->clips[a];
+        float end = (clip.numSamples - 1) * clip.step, worst = 0.0;
+        for (float t = 0.0; t <= end; t += clip.step * 0.29f) {
+            calculateSkeletonPose(skeleton, a, t, &scratch, &palette[0]);
+            for (int v = 0; v < n; v++) {
+                vec4 p(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z, 1.0), skinned;
+                for (int j = 0; j < 4; j++)
+                    skinned += boneWeights[4*v + j] * (palette[boneIDs[4*v + j]] * p);
+                for (int i = 0; i < 3; i++)
+                    worst = max(worst, max(clip.bounds.low[i] - skinned[i], skinned[i] - clip.bounds.high[i]));
+            }
+        }
+        if (worst > 1e-3f * boundsRadius(clip.bounds)) {
+            printf("model%d clip %d: a skinned vertex is %g outside the clip's bounds\n", meshNumber, (int) a, worst);
+            failures++;
+        }
+    }
+    delete skeleton;
+    aiReleaseImport(scene);
+    return failures;
+}
+
+// Returns the number of handles that find the wrong object, or find one after
+// it's been deleted.  Each object's meshId says which object it is.
+static int checkSceneStore() {
+    SceneStore store = SceneStore();
+    vector<ObjectHandle> live, deleted;
+    vector<int> liveIds;
+    for (int i = 0; i < 1000; i++) {
+        live.push_back(addSceneObject(&store));
+        liveIds.push_back(i);
+        store.meshId[i] = i;
+    }
+
+    // Delete at random, then add and copy objects, which reuses the freed slots.
+    srand(2);
+    for (int r = 0; r < 400; r++) {
+        int h = rand() % live.size();
+        removeSceneObject(&store, live[h]);
+        deleted.push_back(live[h]);
+        live.erase(live.begin() + h);
+        liveIds.erase(liveIds.begin() + h);
+    }
+    for (int i = 0; i < 300; i++) {
+        ObjectHandle handle;
+        if (i % 2 == 0) {
+            handle = addSceneObject(&store);
+            store.meshId[store.count - 1] = 1000 + i;
+        } else {
+            handle = copySceneObject(&store, objectIndex(store, live[i]));
+        }
+        live.push_back(handle);
+        liveIds.push_back(store.meshId[store.count - 1]);
+    }
+
+    int failures = store.count == (int) live.size() ? 0 : 1;
+    for (size_t h = 0; h < live.size(); h++) {
+        int i = objectIndex(store, live[h]);
+        if (i < 0 || store.meshId[i] != liveIds[h] || !sameObject(objectHandle(store, i), live[h]))
+            failures++;
+    }
+    for (size_t h = 0; h < deleted.size(); h++)
+        if (objectIndex(store, deleted[h]) >= 0)
+            failures++;
+    if (failures > 0)
+        printf("Scene store: %d handles find the wrong object\n", failures);
+    return failures;
+}
+
+// Returns the number of kernels that disagree with their scalar reference.
+static int checkAngelKernels() {
+    const float tolerance = 1e-5;  // Allows for the additions happening in another order
+    const int n = 37;              // Odd, so the AVX kernels' leftover case runs too
+    float errors[5] = { 0 };
+
+    srand(1);
+    for (int t = 0; t < 1000; t++) {
+        mat4 a = randomMat4(), b = randomMat4(), want;
+        vec4 v(randomFloat(), randomFloat(), randomFloat(), randomFloat()), wantV;
+
+        simd::mat4MulScalar(a, b, want);
+        errors[0] = max(errors[0], relativeError(a * b, want, 16));
+        mat4 c = a;
+        c *= b;
+        errors[0] = max(errors[0], relativeError(c, want, 16));
+
+        simd::mat4VecScalar(a, v, wantV);
+        errors[1] = max(errors[1], relativeError(a * v, wantV, 4));
+
+        simd::mat4TransposeScalar(a, want);
+        errors[2] = max(errors[2], relativeError(transpose(a), want, 16));
+
+        vector<vec4> points(n), got(n), wantPoints(n);
+        for (int i = 0; i < n; i++)
+            points[i] = vec4(randomFloat(), randomFloat(), randomFloat(), randomFloat());
+        transform(a, &points[0], &got[0], n);
+        simd::transformVec4sScalar(a, &points[0].x, &wantPoints[0].x, n);
+        errors[3] = max(errors[3], relativeError(&got[0].x, &wantPoints[0].x, 4*n));
+
+        vector<mat4> mats(n), gotMats(n), wantMats(n);
+        for (int i = 0; i < n; i++) mats[i] = randomMat4();
+        transform(a, &mats[0], &gotMats[0], n);
+        simd::mat4MulBatchScalar(a, mats[0], wantMats[0], n);
+        errors[4] = max(errors[4], relativeError(gotMats[0], wantMats[0], 16*n));
+    }
+
+    const char* names[5] = { "mat4 * mat4", "mat4 * vec4", "transpose", "transform vec4s", "transform mat4s" };
+    int failures = 0;
+    for (int k = 0; k < 5; k++)
+        if (errors[k] > tolerance) {
+            printf("SIMD %s differs from the scalar reference by %g\n", names[k], errors[k]);
+            failures++;
+        }
+    if (failures == 0)
+        printf("SIMD kernels match the scalar reference\n\n");
+    return failures;
+}
+
+// ------ Baselines ----------------------------------------------------------------
+
+static void writeResults(const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL) {
+        printf("Couldn't write %s\n", filename);
+        exit(1);
+    }
+    fprintf(fp, "{\n  \"benchmarks\": {\n");
+    for (size_t i = 0; i < results.size(); i++)
+        fprintf(fp, "    \"%s\": {\"ns_per_op\": %.1f, \"min_ns\": %.1f, \"iterations\": %ld}%s\n",
+                results[i].name.c_str(), results[i].nsPerOp, results[i].minNs, results[i].itersPerRep,
+                i + 1 < results.size() ? "," : "");
+    fprintf(fp, "  }\n}\n");
+    fclose(fp);
+}
+
+// Reads the benchmarks back from a file in the format above, one per line.
+static bool readBaseline(const char* filename, map<string, double>* baseline) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) return false;
+
+    char line[512], name[256];
+    double ns;
+    while (fgets(line, sizeof line, fp) != NULL)
+        if (sscanf(line, " \"%255[^\"]\": {\"ns_per_op\": %lf", name, &ns) == 2)
+            (*baseline)[name] = ns;
+    fclose(fp);
+    return true;
+}
+
+// Returns the number of regressions.
+static int compareWithBaseline(const map<string, double>& baseline, double threshold) {
+    int regressions = 0;
+    printf("\n%-44s %12s %12s %8s\n", "Compared with the baseline", "baseline", "now", "change");
+    for (size_t i = 0; i < results.size(); i++) {
+        map<string, double>::const_iterator b = baseline.find(results[i].name);
+        if (b == baseline.end()) {
+            printf("%-44s %12s %12.1f %8s\n", results[i].name.c_str(), "-", results[i].nsPerOp, "new");
+            continue;
+        }
+        double change = 100.0 * (results[i].nsPerOp - b->second) / b->second;
+        bool regressed = change > threshold;
+        printf("%-44s %12.1f %12.1f %+7.1f%%%s\n", results[i].name.c_str(), b->second,
+               results[i].nsPerOp, change, regressed ? "  REGRESSION" : "");
+        if (regressed) regressions++;
+    }
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    const char* baselineFile = NULL;
+    const char* saveFile = NULL;
+    double threshold = 10.0;  // Percent
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baseline") == 0 && i+1 < argc)
+            baselineFile = argv[++i];
+        else if (strcmp(argv[i], "--save") == 0 && i+1 < argc)
+            saveFile = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i+1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--reps") == 0 && i+1 < argc)
+            measuredReps = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--filter") == 0 && i+1 < argc)
+            filter = argv[++i];
+        else {
+            printf("Unknown option: %s\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    if (checkAngelKernels() > 0) return 1;
+    if (checkClipBounds(56) + checkClipBounds(57) > 0) return 1;
+    if (checkSceneStore() > 0) return 1;
+
+    benchAnimPose(56);
+    benchAnimPose(57);
+    benchClipCompression(56);
+    benchClipCompression(57);
+    benchPoseStageScaling(56);
+    benchSkinning(56);
+    benchSkinning(57);
+    benchSyntheticSkinning(100000, 64);
+    benchMeshData(56);
+    benchMeshData(57);
+    benchMeshData(10);   // The largest mesh, which has no bones
+    benchLoadBitmap(10); // Among the largest textures
+    benchAngel();
+    benchAngelBatch();
+    benchSceneStore(100000);
+
+    if (saveFile != NULL) {
+        writeResults(saveFile);
+        printf("\nSaved %s\n", saveFile);
+    }
+
+    if (baselineFile != NULL) {
+        map<string, double> baseline;
+        if (!readBaseline(baselineFile, &baseline)) {
+            printf("\nNo baseline in %s - record one with 'make perftest-baseline'\n", baselineFile);
+            return 0;
+        }
+        int regressions = compareWithBaseline(baseline, threshold);
+        if (regressions > 0) {
+            printf("\n%d benchmark%s slower than the baseline by more than %.1f%%\n",
+                   regressions, regressions == 1 ? " is" : "s are", threshold);
+            return 1;
+        }
+        printf("\nNo regressions beyond %.1f%%\n", threshold);
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "anim-bake.h"
+#include "texture-buffers.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+static GLuint instanceBuffer, instanceTexture;
+static vector<vec4> instanceData;
+
+BakedClip* bakeClip(const Skeleton* skeleton, int animNum) {
+    TraceZone zone("bakeClip");
+    const SkeletonClip& clip = skeleton->clips[animNum];
+    float end = (clip.numSamples - 1) * clip.step;
+
+    BakedClip* baked = new BakedClip();
+    baked->numBones = max((int) skeleton->boneNode.size(), 1);
+    baked->numSamples = min((int) ceil(end / bakedSampleStep - 1e-4) + 1, maxClipSamples);
+    baked->step = baked->numSamples > 1 ? end / (baked->numSamples - 1) : bakedSampleStep;
+
+    vector<mat4> palette(baked->numBones);
+    vector<vec4> texels;
+    texels.reserve(baked->numSamples * baked->numBones * 3);
+    PoseScratch scratch;
+    for (int s = 0; s < baked->numSamples; s++) {
+        calculateSkeletonPose(skeleton, animNum, s * baked->step, &scratch, &palette[0]);
+        for (int b = 0; b < baked->numBones; b++)
+            appendMatrixRows(palette[b], &texels);
+    }
+
+    baked->gpuBytes = texels.size() * sizeof(vec4);
+    glGenBuffers(1, &baked->buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, baked->buffer);
+    glBufferData(GL_TEXTURE_BUFFER, baked->gpuBytes, &texels[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    baked->texture = createBufferTexture(baked->buffer, GL_RGBA32F);
+    CheckError();
+    return baked;
+}
+
+void initBakedInstances() {
+    glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+    GLfloat zeros[4 * instanceDataTexels] = { 0 };  // Buffers need a data store before they're first sampled
+    glBufferData(GL_TEXTURE_BUFFER, sizeof zeros, zeros, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    instanceTexture = createBufferTexture(instanceBuffer, GL_RGBA32F);
+    CheckError();
+}
+
+int addBakedInstance(const mat4& model, float poseTime) {
+    int index = instanceData.size() / instanceDataTexels;
+    appendMatrixRows(model, &instanceData);
+    instanceData.push_back(vec4(poseTime, 0.0, 0.0, 0.0));
+    return index;
+}
+
+void uploadBakedInstances() {
+    if (instanceData.empty()) return;
+
+    streamTexels(instanceBuffer, instanceData);
+    instanceData.clear();
+}
+
+void useBakedClip(const ShaderVariant* shader, const BakedClip* clip, int firstInstance) {
+    glActiveTexture(GL_TEXTURE0 + bakedPoseUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, clip->texture);
+    glActiveTexture(GL_TEXTURE0 + instanceDataUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform1i(shader->bakedPosesU, bakedPoseUnit);
+    glUniform1i(shader->instanceDataU, instanceDataUnit);
+    glUniform2i(shader->bakedSizeU, clip->numBones, clip->numSamples);
+    glUniform1f(shader->bakedSampleRateU, 1.0 / clip->step);
+    glUniform1i(shader->firstInstanceU, firstInstance);
+}
@@ -0,0 +1,55 @@
+// ------ Baked animation -------------------------------------------------------
+//
+// For crowds of skinned models, posing each instance on the CPU and uploading
+// its palette before every draw costs more than drawing it.  Instead, a clip
+// can be baked when its mesh is first drawn: its palette is calculated about
+// every bakedSampleStep ticks and stored in a texture buffer, three RGBA32F
+// texels (the top three rows of the matrix) per bone per sample.  The BAKED
+// shader variant fetches the palettes either side of an instance's pose time
+// and blends between them, so an animated instance costs no posing at all.
+//
+// Instances are drawn together with glDrawElementsInstanced.  What differs
+// between them goes in a second texture buffer, indexed from gl_InstanceID:
+// the top three rows of the model matrix, then the pose time, four texels per
+// instance.  Everything else (mesh, texture and material) is shared by the
+// instances of a draw.
+
+#ifndef ANIM_BAKE_H
+#define ANIM_BAKE_H
+
+#include "Angel.h"
+#include "shader-cache.h"
+#include "skeleton.h"
+
+const float bakedSampleStep = 0.5f;  // Most ticks between baked palettes, unless capped by maxClipSamples
+
+// Texture units for the baked palettes and the instance data, after the lights'.
+const int bakedPoseUnit = 4, instanceDataUnit = 5;
+
+const int instanceDataTexels = 4;   // Per instance
+
+typedef struct {
+    GLuint buffer, texture;         // The palettes, sample by sample
+    int numBones;                   // Matrices in each palette
+    int numSamples;                 // Palettes, covering the clip
+    float step;                     // Ticks between them, so the last falls on the clip's end
+    long gpuBytes;
+} BakedClip;
+
+// Pose every sample of a clip and upload the palettes.  Needs a current GL context.
+BakedClip* bakeClip(const Skeleton* skeleton, int animNum);
+
+// Create the instance data buffer.  Needs a current GL context.
+void initBakedInstances();
+
+// Append an instance's data, returning its index in this frame's buffer.
+int addBakedInstance(const mat4& model, float poseTime);
+
+// Upload the frame's instance data, and start again for the next frame.
+void uploadBakedInstances();
+
+// Bind a baked clip and the instance data, and point a BAKED variant at them.
+// firstInstance is the index of the draw's first instance.
+void useBakedClip(const ShaderVariant* shader, const BakedClip* clip, int firstInstance);
+
+#endif // ANIM_BAKE_H
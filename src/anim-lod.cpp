@@ -0,0 +1,35 @@
+#include "anim-lod.h"
+#include "shader-cache.h"
+
+#include <math.h>
+
+float projectedRadius(const vec4& eyeCentre, float radius, const mat4& projection, int windowHeight) {
+    float depth = -eyeCentre.z;
+    if (depth <= radius) return HUGE_VALF;
+    return radius * projection[1][1] / depth * 0.5f * windowHeight;
+}
+
+AnimLod animLodFor(float projectedRadius) {
+    if (projectedRadius < animLodQuarterPixels) return ANIM_LOD_QUARTER;
+    if (projectedRadius < animLodHalfPixels) return ANIM_LOD_HALF;
+    return ANIM_LOD_FULL;
+}
+
+int animLodInterval(AnimLod lod) {
+    return 1 << lod;
+}
+
+bool animLodUpdates(AnimLod lod, unsigned slot, int frame) {
+    return (frame + slot) % animLodInterval(lod) == 0;
+}
+
+unsigned animLodShaderFeatures(AnimLod lod) {
+    switch (lod) {
+    case ANIM_LOD_HALF:
+        return SHADER_TWO_BONES;
+    case ANIM_LOD_QUARTER:
+        return SHADER_ONE_BONE;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,54 @@
+// ------ Animation level of detail ---------------------------------------------
+//
+// A skinned object a few pixels high gets the same full pose every frame and
+// the same four-bone blend per vertex as one filling the screen.  Instead each
+// skinned object is given a tier from its projected size, its bounding radius
+// in pixels:
+//
+//   ANIM_LOD_FULL     posed every frame, four bones per vertex
+//   ANIM_LOD_HALF     posed every 2nd frame, the two heaviest bones
+//   ANIM_LOD_QUARTER  posed every 4th frame, the heaviest bone only
+//
+// Objects in the lower tiers keep their last pose between updates, though an
+// object is posed at once when it changes tier or comes into view.  Which
+// frames update is staggered by object, so that a crowd's poses are spread
+// evenly over frames rather than all landing on the same one.  The bone
+// weights from getBonesAffectingEachVertex are sorted heaviest first, so the
+// shader takes the first one or two and renormalises them to sum to one.
+//
+// The thresholds are set so that, at the switch, a held pose moves a vertex
+// by well under a pixel at the animation's usual speed, and the weight
+// dropped from a vertex's lighter bones moves it by about a pixel at most.
+
+#ifndef ANIM_LOD_H
+#define ANIM_LOD_H
+
+#include "Angel.h"
+
+enum AnimLod {
+    ANIM_LOD_FULL = 0,
+    ANIM_LOD_HALF,
+    ANIM_LOD_QUARTER
+};
+
+// Projected radii, in pixels, below which an object drops to each lower tier.
+const float animLodHalfPixels = 48.0f, animLodQuarterPixels = 16.0f;
+
+// The radius, in pixels, of a sphere at eyeCentre (eye coordinates) on a
+// screen windowHeight pixels high.  Spheres around the eye count as huge.
+float projectedRadius(const vec4& eyeCentre, float radius, const mat4& projection, int windowHeight);
+
+AnimLod animLodFor(float projectedRadius);
+
+// Frames between pose updates: 1, 2 or 4.
+int animLodInterval(AnimLod lod);
+
+// Whether an object in this tier is posed on this frame.  Staggered by the
+// object's handle slot (see scene-store.h), which stays put when objects are
+// removed, unlike its index.
+bool animLodUpdates(AnimLod lod, unsigned slot, int frame);
+
+// The shader features that select the tier's bone count (see shader-cache.h).
+unsigned animLodShaderFeatures(AnimLod lod);
+
+#endif // ANIM_LOD_H
@@ -0,0 +1,118 @@
+#include "bench.h"
+#include "Angel.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+bool loadBenchScene(const char* filename, int numMeshes, int numTextures, BenchScene* scene) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Bench: can't open %s\n", filename);
+        return false;
+    }
+
+    scene->objects.clear();
+    scene->numLights = 0;
+    scene->walk = false;
+    scene->frames = 300;
+    scene->warmup = 10;
+
+    char line[256], word[32], arg[32];
+    int lineNum = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof line, fp) != NULL) {
+        lineNum++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+        if (sscanf(line, "%31s", word) != 1) continue;  // Blank
+
+        BenchObjects objects;
+        if (strcmp(word, "objects") == 0)
+            ok = sscanf(line, "%*s %d %d %d", &objects.meshId, &objects.texId, &objects.count) == 3
+                 && objects.meshId >= 0 && objects.meshId < numMeshes
+                 && objects.texId >= 0 && objects.texId < numTextures
+                 && objects.count >= 0;
+        else if (strcmp(word, "lights") == 0)
+            ok = sscanf(line, "%*s %d", &scene->numLights) == 1 && scene->numLights >= 0;
+        else if (strcmp(word, "frames") == 0)
+            ok = sscanf(line, "%*s %d", &scene->frames) == 1 && scene->frames >= 0;
+        else if (strcmp(word, "warmup") == 0)
+            ok = sscanf(line, "%*s %d", &scene->warmup) == 1 && scene->warmup >= 0;
+        else if (strcmp(word, "camera") == 0) {
+            ok = sscanf(line, "%*s %31s", arg) == 1
+                 && (strcmp(arg, "orbit") == 0 || strcmp(arg, "walk") == 0);
+            scene->walk = ok && strcmp(arg, "walk") == 0;
+        } else
+            ok = false;
+
+        if (ok && strcmp(word, "objects") == 0)
+            scene->objects.push_back(objects);
+    }
+    fclose(fp);
+
+    if (!ok)
+        fprintf(stderr, "Bench: %s:%d: can't understand: %s\n", filename, lineNum, line);
+    return ok;
+}
+
+// Nearest-rank percentile of sorted values.
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = (size_t) ceil(p / 100.0 * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void writeBenchReport(const char* filename, const char* sceneFile, const BenchScene& scene,
+                      int width, int height, const vector<FrameStats>& frames) {
+    FILE* fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Bench: can't write %s\n", filename);
+        return;
+    }
+
+    int n = max((int) frames.size(), 1);
+    vector<double> frameMs;
+    double totalMs = 0.0, stageMs[numFrameStages] = { 0 };
+    double drawCalls = 0.0, triangles = 0.0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        frameMs.push_back(frames[i].frameMs);
+        totalMs += frames[i].frameMs;
+        for (int s = 0; s < numFrameStages; s++)
+            stageMs[s] += frames[i].stageMs[s];
+        drawCalls += frames[i].drawCalls;
+        triangles += frames[i].triangles;
+    }
+    sort(frameMs.begin(), frameMs.end());
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);  // ru_maxrss is in kilobytes on Linux
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"scene\": \"%s\",\n", sceneFile);
+    const char* renderer = (const char*) glGetString(GL_RENDERER);
+    fprintf(fp, "  \"renderer\": \"%s\",\n", renderer != NULL ? renderer : "unknown");
+    fprintf(fp, "  \"width\": %d,\n  \"height\": %d,\n", width, height);
+    fprintf(fp, "  \"camera\": \"%s\",\n", scene.walk ? "walk" : "orbit");
+    fprintf(fp, "  \"frames\": %d,\n", (int) frames.size());
+    fprintf(fp, "  \"frame_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+            totalMs / n, percentile(frameMs, 50), percentile(frameMs, 95), percentile(frameMs, 99),
+            frameMs.empty() ? 0.0 : frameMs.back());
+    fprintf(fp, "  \"stage_ms\": {");
+    for (int s = 0; s < numFrameStages; s++)
+        fprintf(fp, "%s \"%s\": %.4f", s > 0 ? "," : "", frameStageNames[s], stageMs[s] / n);
+    fprintf(fp, " },\n");
+    fprintf(fp, "  \"draw_calls\": %.1f,\n", drawCalls / n);
+    fprintf(fp, "  \"triangles\": %.0f,\n", triangles / n);
+    fprintf(fp, "  \"peak_rss_kb\": %ld\n", usage.ru_maxrss);
+    fprintf(fp, "}\n");
+
+    if (fp != stdout) {
+        fclose(fp);
+        printf("Bench: wrote %s\n", filename);
+    }
+}
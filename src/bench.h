@@ -0,0 +1,42 @@
+// ------ Benchmark scenes and reports ----------------------------------------
+//
+// A bench scene is a text file with one directive per line ('#' comments):
+//
+//   objects MESH TEXTURE COUNT   COUNT copies of modelMESH.x with textureTEXTURE.bmp
+//   lights COUNT                 COUNT point lights scattered over the ground
+//   camera orbit|walk            Orbit in design mode, or walk in game mode
+//   frames N                     Frames to measure
+//   warmup N                     Frames drawn first and not measured
+//
+// After a headless run over the scene, the report gives frame-time
+// percentiles, the mean CPU time of each stage, draw calls, triangles and the
+// peak resident set size as JSON, so that builds can be compared.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "frame-stats.h"
+
+#include <vector>
+
+typedef struct {
+    int meshId, texId, count;
+} BenchObjects;
+
+typedef struct {
+    std::vector<BenchObjects> objects;
+    int numLights;
+    bool walk;      // Game-mode walk rather than a design-mode orbit
+    int frames;
+    int warmup;
+} BenchScene;
+
+// Read a scene, printing the problem and returning false if it's malformed or
+// names a mesh or texture outside [0, numMeshes) or [0, numTextures).
+bool loadBenchScene(const char* filename, int numMeshes, int numTextures, BenchScene* scene);
+
+// Write the JSON report for the measured frames.
+void writeBenchReport(const char* filename, const char* sceneFile, const BenchScene& scene,
+                      int width, int height, const std::vector<FrameStats>& frames);
+
+#endif // BENCH_H
@@ -16,6 +16,9 @@
 static unsigned short read_word(FILE *fp);
 static unsigned int   read_dword(FILE *fp);
 static int            read_long(FILE *fp);
+static int            write_word(FILE *fp, unsigned short w);
+static int            write_dword(FILE *fp, unsigned int dw);
+static int            write_long(FILE *fp, int l);
 
 /*
  * 'LoadDIBitmap()' - Load a DIB/BMP file from disk.
@@ -128,6 +131,84 @@ LoadDIBitmap(const char *filename, /* I - File to load */
     return (bits);
     }
 
+/*
+ * 'SaveDIBitmap()' - Save a DIB/BMP file to disk.
+ *
+ * The bits are 24-bit RGB rows padded to 4 bytes, bottom row first, as
+ * LoadDIBitmap returns them.  Returns 0 on success or -1 on error...
+ */
+
+int                                /* O - 0 = success, -1 = failure */
+SaveDIBitmap(const char *filename, /* I - File to save */
+             BITMAPINFO *info,     /* I - Bitmap information */
+	     GLubyte    *bits)     /* I - Bitmap data */
+    {
+    FILE *fp;                      /* Open file pointer */
+    GLubyte *ptr;                  /* Pointer into bitmap */
+    int  x, y;                     /* X and Y position in image */
+    int  length;                   /* Line length */
+    int  bitsize;                  /* Size of bitmap */
+    int  infosize;                 /* Size of bitmap info */
+
+
+    /* Only uncompressed 24-bit images are written */
+    if (info->bmiHeader.biBitCount != 24)
+        return (-1);
+
+    /* Try opening the file; use "wb" mode to write this *binary* file. */
+    if ((fp = fopen(filename, "wb")) == NULL)
+        return (-1);
+
+    length   = (info->bmiHeader.biWidth * 3 + 3) & ~3;
+    bitsize  = length * abs(info->bmiHeader.biHeight);
+    infosize = 40; /* No colormap */
+
+    /* Write the file header, bitmap information, and bitmap pixel data... */
+    write_word(fp, BF_TYPE);                    /* bfType */
+    write_dword(fp, 14 + infosize + bitsize);   /* bfSize */
+    write_word(fp, 0);                          /* bfReserved1 */
+    write_word(fp, 0);                          /* bfReserved2 */
+    write_dword(fp, 14 + infosize);             /* bfOffBits */
+
+    write_dword(fp, infosize);
+    write_long(fp, info->bmiHeader.biWidth);
+    write_long(fp, info->bmiHeader.biHeight);
+    write_word(fp, 1);
+    write_word(fp, 24);
+    write_dword(fp, BI_RGB);
+    write_dword(fp, bitsize);
+    write_long(fp, info->bmiHeader.biXPelsPerMeter);
+    write_long(fp, info->bmiHeader.biYPelsPerMeter);
+    write_dword(fp, 0);
+    write_dword(fp, 0);
+
+    /* Swap red and blue back to the file's BGR order, a line at a time */
+    for (y = 0; y < abs(info->bmiHeader.biHeight); y ++)
+        {
+        for (ptr = bits + y * length, x = info->bmiHeader.biWidth;
+             x > 0;
+	     x --, ptr += 3)
+	    {
+	    putc(ptr[2], fp);
+	    putc(ptr[1], fp);
+	    putc(ptr[0], fp);
+	    }
+        for (x = info->bmiHeader.biWidth * 3; x < length; x ++)
+            putc(0, fp);
+        }
+
+    if (ferror(fp))
+        {
+        /* Couldn't write the bitmap - close the file and return an error */
+        fclose(fp);
+        return (-1);
+        }
+
+    /* OK, everything went fine - return... */
+    fclose(fp);
+    return (0);
+    }
+
 /*
  * 'read_word()' - Read a 16-bit unsigned integer.
  */
@@ -178,3 +259,46 @@ read_long(FILE *fp)               /* I - File to read from */
 
     return ((int)(((((b3 << 8) | b2) << 8) | b1) << 8) | b0);
     }
+
+
+/*
+ * 'write_word()' - Write a 16-bit unsigned integer.
+ */
+
+static int                     /* O - Last byte written or EOF */
+write_word(FILE           *fp, /* I - File to write to */
+           unsigned short w)   /* I - Integer to write */
+    {
+    putc(w, fp);
+    return (putc(w >> 8, fp));
+    }
+
+
+/*
+ * 'write_dword()' - Write a 32-bit unsigned integer.
+ */
+
+static int                    /* O - Last byte written or EOF */
+write_dword(FILE         *fp, /* I - File to write to */
+            unsigned int dw)  /* I - Integer to write */
+    {
+    putc(dw, fp);
+    putc(dw >> 8, fp);
+    putc(dw >> 16, fp);
+    return (putc(dw >> 24, fp));
+    }
+
+
+/*
+ * 'write_long()' - Write a 32-bit signed integer.
+ */
+
+static int           /* O - Last byte written or EOF */
+write_long(FILE *fp, /* I - File to write to */
+           int  l)   /* I - Integer to write */
+    {
+    putc(l, fp);
+    putc(l >> 8, fp);
+    putc(l >> 16, fp);
+    return (putc(l >> 24, fp));
+    }
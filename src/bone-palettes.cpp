@@ -0,0 +1,48 @@
+#include "bone-palettes.h"
+#include "texture-buffers.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+static GLuint paletteBuffer, paletteTexture;
+static GLint maxTexels;               // GL_MAX_TEXTURE_BUFFER_SIZE
+static vector<vec4> texels;
+
+void initBonePalettes() {
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+
+    glGenBuffers(1, &paletteBuffer);
+    uploadBonePalettes(NULL, 0);  // Just the identity, so the buffer is never sampled empty
+    paletteTexture = createBufferTexture(paletteBuffer, GL_RGBA32F);
+    CheckError();
+}
+
+void uploadBonePalettes(const mat4* palettes, int count) {
+    TraceZone zone("uploadBonePalettes");
+    texels.clear();
+    appendMatrixRows(mat4(1.0), &texels);
+    for (int m = 0; m < count; m++)
+        appendMatrixRows(palettes[m], &texels);
+
+    if ((long) texels.size() > maxTexels) {
+        fprintf(stderr, "Bone palettes: %d matrices this frame, but texture buffers hold at most %d\n",
+                count + 1, maxTexels / 3);
+        exit(EXIT_FAILURE);
+    }
+
+    streamTexels(paletteBuffer, texels);
+}
+
+void bindBonePalettes() {
+    glActiveTexture(GL_TEXTURE0 + bonePaletteUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void setBonePaletteUniforms(const ShaderVariant* shader) {
+    glUniform1i(shader->bonePalettesU, bonePaletteUnit);
+}
@@ -0,0 +1,45 @@
+// ------ Bone palette buffer ---------------------------------------------------
+//
+// Skinned draws used to upload their palette into a uniform array of 64
+// matrices before each draw call, which capped skeletons at 64 bones and cost
+// an upload per object.  Instead, once the animation stage has calculated the
+// frame's poses, the pose cache's whole buffer of palettes goes into one
+// texture buffer in a single upload, three RGBA32F texels (the top three rows)
+// per matrix.  Each draw then only sets PaletteBase, the index of its
+// palette's first matrix, and the vertex shader fetches its bones from there.
+// A palette can have as many bones as the buffer has room for.
+//
+// The buffer starts with one identity matrix, at identityPalette, for skinned
+// variants standing in for unskinned ones.  The pose cache's palettes follow
+// it, so a palette's base is its pose cache offset plus one.
+
+#ifndef BONE_PALETTES_H
+#define BONE_PALETTES_H
+
+#include "Angel.h"
+#include "shader-cache.h"
+
+// The texture unit for the palettes, after the baked animation's.
+const int bonePaletteUnit = 6;
+
+const int identityPalette = 0;
+
+// The base of the palette at a pose cache offset, or identityPalette for -1.
+inline int paletteBase(int poseOffset) {
+    return poseOffset < 0 ? identityPalette : poseOffset + 1;
+}
+
+// Create the buffer and texture.  Needs a current GL context.
+void initBonePalettes();
+
+// Upload the frame's palettes (count matrices, from the pose cache).  Exits if
+// they don't fit in the largest texture buffer the driver allows.
+void uploadBonePalettes(const mat4* palettes, int count);
+
+// Bind the palettes to their texture unit.
+void bindBonePalettes();
+
+// Point a shader variant's BonePalettes sampler at the texture unit.
+void setBonePaletteUniforms(const ShaderVariant* shader);
+
+#endif // BONE_PALETTES_H
@@ -0,0 +1,54 @@
+#include "bounds.h"
+
+#include <algorithm>
+#include <float.h>
+
+using namespace std;
+
+Bounds emptyBounds() {
+    Bounds bounds = { vec3(FLT_MAX, FLT_MAX, FLT_MAX), vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+    return bounds;
+}
+
+void addPoint(Bounds* bounds, const vec3& p) {
+    addSphere(bounds, p, 0.0);
+}
+
+void addSphere(Bounds* bounds, const vec3& centre, float radius) {
+    for (int i = 0; i < 3; i++) {
+        bounds->low[i] = min(bounds->low[i], centre[i] - radius);
+        bounds->high[i] = max(bounds->high[i], centre[i] + radius);
+    }
+}
+
+void addBounds(Bounds* bounds, const Bounds& other) {
+    for (int i = 0; i < 3; i++) {
+        bounds->low[i] = min(bounds->low[i], other.low[i]);
+        bounds->high[i] = max(bounds->high[i], other.high[i]);
+    }
+}
+
+vec3 boundsCentre(const Bounds& bounds) {
+    return bounds.low.x > bounds.high.x ? vec3(0.0, 0.0, 0.0) : (bounds.low + bounds.high) / 2.0;
+}
+
+float boundsRadius(const Bounds& bounds) {
+    return bounds.low.x > bounds.high.x ? 0.0 : length(bounds.high - bounds.low) / 2.0;
+}
+
+// Each plane is the last row of the projection plus or minus another (Gribb and Hartmann).
+void frustumPlanes(const mat4& projection, vec4 planes[6]) {
+    for (int i = 0; i < 3; i++) {
+        planes[2*i] = projection[3] + projection[i];
+        planes[2*i + 1] = projection[3] - projection[i];
+    }
+    for (int p = 0; p < 6; p++)
+        planes[p] /= length(vec3(planes[p].x, planes[p].y, planes[p].z));
+}
+
+bool sphereOutside(const vec4 planes[6], const vec4& eyeCentre, float radius) {
+    vec4 c(eyeCentre.x, eyeCentre.y, eyeCentre.z, 1.0);
+    for (int p = 0; p < 6; p++)
+        if (dot(planes[p], c) < -radius) return true;
+    return false;
+}
@@ -0,0 +1,34 @@
+// ------ Bounding volumes -------------------------------------------------------
+//
+// Axis-aligned boxes in a mesh's own coordinates, and the frustum test the
+// culling stage uses them for.  A skinned mesh's box has to hold it in every
+// pose, so each compiled clip gets one that covers the whole clip (see
+// skeleton.h); the walk along an object's path is in its model matrix, so it
+// needs no allowance here.
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "Angel.h"
+
+typedef struct {
+    vec3 low, high;   // low > high when empty
+} Bounds;
+
+Bounds emptyBounds();
+void addPoint(Bounds* bounds, const vec3& p);
+void addSphere(Bounds* bounds, const vec3& centre, float radius);
+void addBounds(Bounds* bounds, const Bounds& other);
+
+// The sphere round the box.
+vec3 boundsCentre(const Bounds& bounds);
+float boundsRadius(const Bounds& bounds);
+
+// The six planes of the view frustum in eye coordinates, facing inwards, with
+// unit normals (xyz).
+void frustumPlanes(const mat4& projection, vec4 planes[6]);
+
+// True if a sphere in eye coordinates is entirely outside one of the planes.
+bool sphereOutside(const vec4 planes[6], const vec4& eyeCentre, float radius);
+
+#endif // BOUNDS_H
@@ -0,0 +1,195 @@
+#include "clip-compress.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+static const float smallestThreeRange = 0.70710678f;  // No other component can exceed 1/sqrt(2)
+
+// Keys are kept at least this often, which bounds the cost of reducing them.
+static const int maxKeyGap = 256;
+
+// ------ Quantising ------
+
+static unsigned short quantise(float value, float low, float extent, int bits) {
+    int most = (1 << bits) - 1;
+    if (extent <= 0.0f) return 0;
+    return (unsigned short) max(0, min(most, (int) lround((value - low) / extent * most)));
+}
+
+static float dequantise(unsigned short q, float low, float extent, int bits) {
+    return low + q * extent / ((1 << bits) - 1);
+}
+
+static void encodeVector(const vec3& v, const CompressedTrack& track, unsigned short* out) {
+    for (int i = 0; i < 3; i++)
+        out[i] = quantise(v[i], track.low[i], track.extent[i], 16);
+}
+
+static vec4 decodeVector(const unsigned short* in, const CompressedTrack& track) {
+    return vec4(dequantise(in[0], track.low.x, track.extent.x, 16),
+                dequantise(in[1], track.low.y, track.extent.y, 16),
+                dequantise(in[2], track.low.z, track.extent.z, 16), 0.0);
+}
+
+static void encodeRotation(vec4 q, unsigned short* out) {
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+        if (fabs(q[i]) > fabs(q[largest])) largest = i;
+    if (q[largest] < 0.0f) q = -q;  // q and -q are the same rotation, so the dropped one is positive
+
+    for (int i = 0, j = 0; i < 4; i++)
+        if (i != largest)
+            out[j++] = quantise(q[i], -smallestThreeRange, 2.0f * smallestThreeRange, 15);
+    out[0] |= (largest & 1) << 15;
+    out[1] |= (largest >> 1) << 15;
+}
+
+static vec4 decodeRotation(const unsigned short* in) {
+    int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+    float others[3], sumSquares = 0.0f;
+    for (int j = 0; j < 3; j++) {
+        others[j] = dequantise(in[j] & 0x7FFF, -smallestThreeRange, 2.0f * smallestThreeRange, 15);
+        sumSquares += others[j] * others[j];
+    }
+
+    vec4 q;
+    for (int i = 0, j = 0; i < 4; i++)
+        q[i] = i == largest ? sqrt(max(0.0f, 1.0f - sumSquares)) : others[j++];
+    return q;
+}
+
+// ------ Key reduction ------
+
+static float vectorError(const vec4& a, const vec4& b, float weight1, const vec4& sample) {
+    return length(a * (1.0f - weight1) + b * weight1 - sample);
+}
+
+// As skeleton.cpp's slerp, returning the angle to sample instead.
+static float rotationError(const vec4& a, const vec4& b, float weight1, const vec4& sample) {
+    float cosom = dot(a, b);
+    vec4 end = cosom < 0.0f ? -b : b;
+    cosom = fabs(cosom);
+    float sclp = 1.0f - weight1, sclq = weight1;
+    if (1.0f - cosom > 0.0001f) {
+        float omega = acos(cosom), sinom = sin(omega);
+        sclp = sin((1.0f - weight1) * omega) / sinom;
+        sclq = sin(weight1 * omega) / sinom;
+    }
+    vec4 q = sclp * a + sclq * end;
+    q = q / length(q);
+
+    // Twice the angle between the quaternions, which acos loses near 1.
+    vec4 s = dot(q, sample) < 0.0f ? -sample : sample;
+    return 4.0f * atan2(length(q - s), length(q + s));
+}
+
+typedef float (*KeyError)(const vec4& a, const vec4& b, float weight1, const vec4& sample);
+
+// Greedily keep the furthest key that the samples since the last kept key can
+// be interpolated to within tolerance.  The first and last samples are always kept.
+static vector<int> reduceKeys(const vector<vec4>& samples, KeyError error, float tolerance) {
+    int n = samples.size();
+    vector<int> kept(1, 0);
+
+    // Most channels don't move at all, and need no more than their ends.
+    bool still = true;
+    for (int k = 1; k < n && still; k++)
+        still = error(samples[0], samples[0], 0.0f, samples[k]) <= 0.5f * tolerance;
+
+    int from = 0;
+    for (int to = 2; to < n && !still; to++) {
+        bool fits = to - from <= maxKeyGap;
+        for (int k = from + 1; k < to && fits; k++)
+            fits = error(samples[from], samples[to], (float) (k - from) / (to - from), samples[k]) <= tolerance;
+        if (!fits) {
+            from = to - 1;
+            kept.push_back(from);
+        }
+    }
+    if (n > 1) kept.push_back(n - 1);
+    return kept;
+}
+
+static void addTrack(SkeletonClip* clip, const vector<vec4>& samples, bool isRotation, float tolerance) {
+    CompressedTrack track;
+    track.firstKey = clip->keySamples.size();
+
+    vec4 low = samples[0], high = samples[0];
+    for (size_t k = 1; k < samples.size(); k++)
+        for (int i = 0; i < 3; i++) {
+            low[i] = min(low[i], samples[k][i]);
+            high[i] = max(high[i], samples[k][i]);
+        }
+    track.low = vec3(low.x, low.y, low.z);
+    track.extent = vec3(high.x - low.x, high.y - low.y, high.z - low.z);
+
+    vector<int> kept = reduceKeys(samples, isRotation ? rotationError : vectorError, tolerance);
+    track.numKeys = kept.size();
+    for (size_t i = 0; i < kept.size(); i++) {
+        unsigned short values[3];
+        const vec4& v = samples[kept[i]];
+        if (isRotation)
+            encodeRotation(v, values);
+        else
+            encodeVector(vec3(v.x, v.y, v.z), track, values);
+        clip->keySamples.push_back(kept[i]);
+        clip->keyValues.insert(clip->keyValues.end(), values, values + 3);
+    }
+    clip->tracks.push_back(track);
+}
+
+void compressClip(SkeletonClip* clip, const ClipTolerance& tolerance) {
+    if (clip->compressed) return;
+
+    int n = clip->numSamples;
+    vector<vec4> samples(n);
+    for (size_t c = 0; c < clip->channelNode.size(); c++) {
+        for (int k = 0; k < n; k++) samples[k] = vec4(clip->positions[c * n + k], 0.0);
+        addTrack(clip, samples, false, tolerance.position);
+        for (int k = 0; k < n; k++) samples[k] = clip->rotations[c * n + k];
+        addTrack(clip, samples, true, tolerance.rotation);
+        for (int k = 0; k < n; k++) samples[k] = vec4(clip->scales[c * n + k], 0.0);
+        addTrack(clip, samples, false, tolerance.scale);
+    }
+
+    vector<vec3>().swap(clip->positions);
+    vector<vec4>().swap(clip->rotations);
+    vector<vec3>().swap(clip->scales);
+    clip->compressed = true;
+}
+
+void compressSkeleton(Skeleton* skeleton, const ClipTolerance& tolerance) {
+    for (size_t a = 0; a < skeleton->clips.size(); a++)
+        compressClip(&skeleton->clips[a], tolerance);
+}
+
+long clipBytes(const SkeletonClip& clip) {
+    return sizeof clip + clip.channelNode.size() * sizeof(int) +
+           clip.positions.size() * sizeof(vec3) + clip.rotations.size() * sizeof(vec4) +
+           clip.scales.size() * sizeof(vec3) + clip.tracks.size() * sizeof(CompressedTrack) +
+           clip.keySamples.size() * sizeof(unsigned short) + clip.keyValues.size() * sizeof(unsigned short);
+}
+
+float keptKeyFraction(const SkeletonClip& clip) {
+    long samples = (long) clip.numSamples * clip.tracks.size();
+    return samples > 0 ? (float) clip.keySamples.size() / samples : 1.0f;
+}
+
+void findCompressedKeys(const SkeletonClip& clip, int track, float at,
+                        vec4* key0, vec4* key1, float* weight1) {
+    const CompressedTrack& t = clip.tracks[track];
+    const unsigned short* samples = &clip.keySamples[t.firstKey];
+
+    // The last key at or before at, stopping one short of the end so there's a next key.
+    int i = upper_bound(samples, samples + t.numKeys, at) - samples - 1;
+    i = max(0, min(i, t.numKeys - 2));
+    int j = min(i + 1, t.numKeys - 1);
+
+    const unsigned short* values = &clip.keyValues[3 * t.firstKey];
+    bool isRotation = track % 3 == 1;
+    *key0 = isRotation ? decodeRotation(values + 3 * i) : decodeVector(values + 3 * i, t);
+    *key1 = isRotation ? decodeRotation(values + 3 * j) : decodeVector(values + 3 * j, t);
+    *weight1 = i == j ? 0.0f : max(0.0f, min(1.0f, (at - samples[i]) / (samples[j] - samples[i])));
+}
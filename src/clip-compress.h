@@ -0,0 +1,53 @@
+// ------ Animation clip compression --------------------------------------------
+//
+// A compiled clip (skeleton.h) holds every channel at every sample as floats,
+// 40 bytes a sample, although most channels barely move and the rest move
+// smoothly.  Compressing a clip replaces the samples with keys:
+//
+//   key reduction   a sample is dropped when interpolating between the keys
+//                   either side of it stays within the tolerance, so a still
+//                   channel keeps only its first and last keys
+//   rotations       smallest three: the largest component of the quaternion is
+//                   dropped (it follows from the others, as |q| = 1) and the
+//                   other three are stored in 15 bits each, with the dropped
+//                   component's index in the two spare bits
+//   positions and   16 bits per component, over the range the channel covers
+//   scales
+//
+// Each key is then 8 bytes: its sample number and three 16-bit values.
+// Posing a compressed clip finds the keys either side of the pose time in
+// each channel by binary search, and interpolates between them as before.
+
+#ifndef CLIP_COMPRESS_H
+#define CLIP_COMPRESS_H
+
+#include "skeleton.h"
+
+// How far the kept keys may stray from the dropped samples, before quantising.
+typedef struct {
+    float position;   // Distance, in the model's units
+    float rotation;   // Angle, in radians
+    float scale;      // Difference in each component
+} ClipTolerance;
+
+const ClipTolerance defaultClipTolerance = { 0.01f, 0.001f, 0.001f };
+
+// Replace a clip's samples with reduced, quantised keys.
+void compressClip(SkeletonClip* clip, const ClipTolerance& tolerance);
+
+// Compress every clip of a skeleton.
+void compressSkeleton(Skeleton* skeleton, const ClipTolerance& tolerance);
+
+// Bytes held by a clip's samples or keys.
+long clipBytes(const SkeletonClip& clip);
+
+// Keys kept over samples that were there before compressing, as a fraction.
+float keptKeyFraction(const SkeletonClip& clip);
+
+// Tracks are numbered 3*channel for positions, then rotations, then scales.
+// Decode the keys either side of at (in samples) and the weight of the second;
+// positions and scales come back in xyz.
+void findCompressedKeys(const SkeletonClip& clip, int track, float at,
+                        vec4* key0, vec4* key1, float* weight1);
+
+#endif // CLIP_COMPRESS_H
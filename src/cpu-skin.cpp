@@ -0,0 +1,105 @@
+#include "cpu-skin.h"
+#include "jobs.h"
+#include "trace.h"
+
+void initSkinnedVertices(SkinnedVertices* out, int numVertices) {
+    out->numVertices = numVertices;
+    out->x.resize(numVertices);
+    out->y.resize(numVertices);
+    out->z.resize(numVertices);
+    out->nx.resize(numVertices);
+    out->ny.resize(numVertices);
+    out->nz.resize(numVertices);
+}
+
+void initSkinSource(SkinSource* source, int numVertices, const float* positions, const float* normals,
+                    const GLint boneIDs[][4], const GLfloat boneWeights[][4]) {
+    initSkinnedVertices(&source->rest, numVertices);
+    source->boneIDs.assign(&boneIDs[0][0], &boneIDs[0][0] + 4 * numVertices);
+    source->boneWeights.assign(&boneWeights[0][0], &boneWeights[0][0] + 4 * numVertices);
+    for (int v = 0; v < numVertices; v++) {
+        source->rest.x[v] = positions[3*v];
+        source->rest.y[v] = positions[3*v + 1];
+        source->rest.z[v] = positions[3*v + 2];
+        source->rest.nx[v] = normals[3*v];
+        source->rest.ny[v] = normals[3*v + 1];
+        source->rest.nz[v] = normals[3*v + 2];
+    }
+}
+
+void skinVerticesScalar(const SkinSource& source, const mat4* palette, int begin, int end,
+                        SkinnedVertices* out) {
+    const SkinnedVertices& rest = source.rest;
+    for (int v = begin; v < end; v++) {
+        // The top three rows of the blended matrix; the last is always (0, 0, 0, 1).
+        GLfloat m[12] = { 0 };
+        for (int j = 0; j < 4; j++) {
+            const GLfloat* bone = (const GLfloat*) palette[source.boneIDs[4*v + j]];
+            GLfloat w = source.boneWeights[4*v + j];
+            for (int i = 0; i < 12; i++) m[i] += w * bone[i];
+        }
+
+        float px = rest.x[v], py = rest.y[v], pz = rest.z[v];
+        float nx = rest.nx[v], ny = rest.ny[v], nz = rest.nz[v];
+        out->x[v] = m[0]*px + m[1]*py + m[2]*pz + m[3];
+        out->y[v] = m[4]*px + m[5]*py + m[6]*pz + m[7];
+        out->z[v] = m[8]*px + m[9]*py + m[10]*pz + m[11];
+        out->nx[v] = m[0]*nx + m[1]*ny + m[2]*nz;
+        out->ny[v] = m[4]*nx + m[5]*ny + m[6]*nz;
+        out->nz[v] = m[8]*nx + m[9]*ny + m[10]*nz;
+    }
+}
+
+#ifdef ANGEL_SSE
+// Vertices [v, v+4): blend each one's rows, then transpose so that each
+// register holds one matrix element for all four, and transform them together.
+static inline void skinFourSSE(const SkinSource& source, const mat4* palette, int v, SkinnedVertices* out) {
+    __m128 rows[3][4];  // [row][vertex]
+    for (int lane = 0; lane < 4; lane++) {
+        const GLint* ids = &source.boneIDs[4 * (v + lane)];
+        const GLfloat* weights = &source.boneWeights[4 * (v + lane)];
+        __m128 r0 = _mm_setzero_ps(), r1 = _mm_setzero_ps(), r2 = _mm_setzero_ps();
+        for (int j = 0; j < 4; j++) {
+            const GLfloat* bone = (const GLfloat*) palette[ids[j]];
+            __m128 w = _mm_set1_ps(weights[j]);
+            r0 = _mm_add_ps(r0, _mm_mul_ps(w, _mm_loadu_ps(bone)));
+            r1 = _mm_add_ps(r1, _mm_mul_ps(w, _mm_loadu_ps(bone + 4)));
+            r2 = _mm_add_ps(r2, _mm_mul_ps(w, _mm_loadu_ps(bone + 8)));
+        }
+        rows[0][lane] = r0;
+        rows[1][lane] = r1;
+        rows[2][lane] = r2;
+    }
+
+    const SkinnedVertices& rest = source.rest;
+    __m128 px = _mm_loadu_ps(&rest.x[v]), py = _mm_loadu_ps(&rest.y[v]), pz = _mm_loadu_ps(&rest.z[v]);
+    __m128 nx = _mm_loadu_ps(&rest.nx[v]), ny = _mm_loadu_ps(&rest.ny[v]), nz = _mm_loadu_ps(&rest.nz[v]);
+    float* positions[3] = { &out->x[v], &out->y[v], &out->z[v] };
+    float* normals[3] = { &out->nx[v], &out->ny[v], &out->nz[v] };
+    for (int r = 0; r < 3; r++) {
+        __m128 c0 = rows[r][0], c1 = rows[r][1], c2 = rows[r][2], c3 = rows[r][3];
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);  // Now c0 is element (r, 0) of each vertex's matrix, and so on
+        __m128 n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, nx), _mm_mul_ps(c1, ny)), _mm_mul_ps(c2, nz));
+        _mm_storeu_ps(positions[r], _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, px), _mm_mul_ps(c1, py)),
+                                               _mm_add_ps(_mm_mul_ps(c2, pz), c3)));
+        _mm_storeu_ps(normals[r], n);
+    }
+}
+#endif
+
+void skinVerticesRange(const SkinSource& source, const mat4* palette, int begin, int end,
+                       SkinnedVertices* out) {
+    int v = begin;
+#ifdef ANGEL_SSE
+    for (; v + 4 <= end; v += 4)
+        skinFourSSE(source, palette, v, out);
+#endif
+    skinVerticesScalar(source, palette, v, end, out);
+}
+
+void skinVertices(const SkinSource& source, const mat4* palette, SkinnedVertices* out) {
+    TraceZone zone("skinVertices");
+    parallelFor(source.rest.numVertices, 2048, [&](int begin, int end) {
+        skinVerticesRange(source, palette, begin, end, out);
+    });
+}
@@ -0,0 +1,55 @@
+// ------ CPU skinning ----------------------------------------------------------
+//
+// Only the vertex shader knows where an animated mesh's vertices are, so
+// anything on the CPU that needs the posed triangles (picking, collision,
+// saving a posed mesh) has to skin them itself.  These kernels do the same
+// sum as vStart.glsl: each vertex is moved by the weighted sum of its four
+// bones' matrices, as given by getBonesAffectingEachVertex, and its normal by
+// the same matrix (without renormalising, as the shader leaves that until
+// after the model-view matrix).
+//
+// Positions and normals are kept as structures of arrays, one array per
+// coordinate, both going in and coming out, so the SSE kernel can work on four
+// vertices at once: it blends each vertex's matrix a row at a time, transposes
+// four vertices' matrices, and transforms their coordinates side by side.  The
+// scalar version is the reference that perf/perftest checks it against.
+// skinVertices splits the vertices over the job threads.
+
+#ifndef CPU_SKIN_H
+#define CPU_SKIN_H
+
+#include "Angel.h"
+
+#include <vector>
+
+typedef struct {
+    int numVertices;
+    std::vector<float> x, y, z;       // Positions
+    std::vector<float> nx, ny, nz;    // Normals
+} SkinnedVertices;
+
+typedef struct {
+    SkinnedVertices rest;             // As the mesh is, unposed
+    std::vector<GLint> boneIDs;       // Four per vertex
+    std::vector<GLfloat> boneWeights;
+} SkinSource;
+
+// Copy a mesh's vertices into a source.  positions and normals hold three
+// floats per vertex (as aiVector3D does); the bones are as from
+// getBonesAffectingEachVertex.
+void initSkinSource(SkinSource* source, int numVertices, const float* positions, const float* normals,
+                    const GLint boneIDs[][4], const GLfloat boneWeights[][4]);
+
+// Size out for the source's vertices.
+void initSkinnedVertices(SkinnedVertices* out, int numVertices);
+
+// Skin vertices [begin, end) with a palette from calculateSkeletonPose.
+void skinVerticesScalar(const SkinSource& source, const mat4* palette, int begin, int end,
+                        SkinnedVertices* out);
+void skinVerticesRange(const SkinSource& source, const mat4* palette, int begin, int end,
+                       SkinnedVertices* out);
+
+// Skin every vertex, spread over the job threads.  out must already be sized.
+void skinVertices(const SkinSource& source, const mat4* palette, SkinnedVertices* out);
+
+#endif // CPU_SKIN_H
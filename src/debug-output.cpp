@@ -0,0 +1,108 @@
+#include "debug-output.h"
+#include "gl-extra.h"
+
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+
+// Read by CheckError() in debug builds.
+bool glDebugOutputActive = false;
+
+#ifndef NDEBUG
+static std::mutex messageMutex;
+static std::map<std::string, int> messageCounts;
+
+static const char* sourceName(GLenum source) {
+    switch (source) {
+    case GL_DEBUG_SOURCE_API:             return "API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:   return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY:     return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION:     return "application";
+    default:                              return "other";
+    }
+}
+
+static const char* typeName(GLenum type) {
+    switch (type) {
+    case GL_DEBUG_TYPE_ERROR:               return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "undefined behaviour";
+    case GL_DEBUG_TYPE_PORTABILITY:         return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE:         return "performance";
+    default:                                return "other";
+    }
+}
+
+static const char* severityName(GLenum severity) {
+    switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH:   return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+    case GL_DEBUG_SEVERITY_LOW:    return "low";
+    default:                       return "notification";
+    }
+}
+
+static void GLAPIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                     GLsizei length, const GLchar* message, const void* userParam) {
+    char header[128];
+    snprintf(header, sizeof header, "[GL %s %s, %s severity, id %u]",
+             sourceName(source), typeName(type), severityName(severity), id);
+    std::string key = std::string(header) + " " + std::string(message, length >= 0 ? length : strlen(message));
+
+    std::lock_guard<std::mutex> lock(messageMutex);
+    if (messageCounts[key]++ == 0) {
+        fprintf(stderr, "%s\n", key.c_str());
+        fflush(stderr);
+    }
+}
+
+static void reportRepeats() {
+    std::lock_guard<std::mutex> lock(messageMutex);
+    for (std::map<std::string, int>::iterator it = messageCounts.begin(); it != messageCounts.end(); ++it)
+        if (it->second > 1)
+            fprintf(stderr, "(%d times) %s\n", it->second, it->first.c_str());
+}
+#endif
+
+bool parseDebugLevel(const char* name, DebugLevel* level) {
+    if (strcmp(name, "high") == 0)        *level = DEBUG_LEVEL_HIGH;
+    else if (strcmp(name, "medium") == 0) *level = DEBUG_LEVEL_MEDIUM;
+    else if (strcmp(name, "low") == 0)    *level = DEBUG_LEVEL_LOW;
+    else if (strcmp(name, "all") == 0)    *level = DEBUG_LEVEL_NOTIFICATION;
+    else return false;
+    return true;
+}
+
+void initDebugOutput(DebugLevel level) {
+#ifndef NDEBUG
+    if (glExtDebugMessageCallback == NULL || glExtDebugMessageControl == NULL) {
+        printf("GL_KHR_debug isn't available: errors are checked with glGetError\n");
+        return;
+    }
+
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+        printf("Not a debug context: the driver may report fewer GL messages\n");
+
+    // By default only low-severity messages are off; set each level explicitly.
+    const GLenum severities[] = { GL_DEBUG_SEVERITY_HIGH, GL_DEBUG_SEVERITY_MEDIUM,
+                                  GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_NOTIFICATION };
+    for (int i = 0; i < 4; i++)
+        glExtDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severities[i], 0, NULL, i <= level);
+    glExtDebugMessageControl(GL_DEBUG_SOURCE_SHADER_COMPILER, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_FALSE);
+
+    // Synchronous output calls back on the thread, and within the call, that caused it.
+    glExtDebugMessageCallback(debugCallback, NULL);
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    atexit(reportRepeats);
+
+    CheckError(); // The last poll: from here on the callback reports errors
+    glDebugOutputActive = true;
+#endif
+}
@@ -0,0 +1,30 @@
+// ------ GL debug output -------------------------------------------------------
+//
+// In debug builds, GL errors and warnings are reported by a GL_KHR_debug
+// callback as each call makes them, rather than by CheckError() polling
+// glGetError, which can make the driver wait for the GPU.  Once the callback
+// is installed CheckError() does nothing; in release builds (NDEBUG) it
+// compiles away entirely and so does this.
+//
+// Messages less severe than the chosen level are filtered out by the driver,
+// as are shader compiler messages (shader-cache.cpp prints the compile logs
+// itself).  Each distinct message is printed once; repeats are counted and
+// summarised when the program exits.
+
+#ifndef DEBUG_OUTPUT_H
+#define DEBUG_OUTPUT_H
+
+enum DebugLevel {
+    DEBUG_LEVEL_HIGH,          // Errors and undefined behaviour
+    DEBUG_LEVEL_MEDIUM,        // ... and major performance warnings
+    DEBUG_LEVEL_LOW,           // ... and minor ones
+    DEBUG_LEVEL_NOTIFICATION   // Everything the driver says
+};
+
+// Install the callback if the context supports it.  Needs loadGLExtra().
+void initDebugOutput(DebugLevel level);
+
+// Parse "high", "medium", "low" or "all".  Returns false for anything else.
+bool parseDebugLevel(const char* name, DebugLevel* level);
+
+#endif // DEBUG_OUTPUT_H
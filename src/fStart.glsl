@@ -1,5 +1,12 @@
 #version 150
 
+// Feature defines are inserted after the #version line by shader-cache.cpp.
+// Without them (e.g. via InitShader) the texture and Alpha are used.
+#ifndef VARIANT
+#define TEXTURED
+#define ALPHA
+#endif
+
 in vec2 texCoord;  // The third coordinate is always 0.0 and is discarded
 in vec3 pos;
 in vec3 N;
@@ -9,13 +16,25 @@ out vec4 fColor;
 uniform sampler2D texture;
 uniform float texScale;
 
-uniform vec4 LightPosition1;
-uniform vec3 AmbientProduct1, DiffuseProduct1, SpecularProduct1;
-uniform vec4 LightPosition2;
-uniform vec3 AmbientProduct2, DiffuseProduct2, SpecularProduct2;
+// The object's material: colour (rgb * brightness) and the amount of each light component
+uniform vec3 MaterialColor;
+uniform float Ambient, Diffuse, Specular;
 uniform float Shininess;
 uniform float Alpha;
 
+// Lights, two texels each: eye position (w=0 for a direction), then rgb * brightness
+// and range.  Directional lights come first.  See lights.h.
+uniform samplerBuffer LightData;
+uniform int NumDirLights;
+uniform vec3 AmbientLight;  // Sum of the directional lights' colours
+
+// Clusters: (offset, count) into LightIndices for each tile and depth slice
+uniform usamplerBuffer ClusterGrid;
+uniform usamplerBuffer LightIndices;
+uniform ivec3 ClusterDims;   // Tiles across, tiles up, depth slices
+uniform vec2 ClusterDepth;   // Near plane, slices per unit of log(depth)
+uniform vec2 ScreenSize;
+
 uniform mat4 View;
 
 void
@@ -26,66 +45,80 @@ main()
 
     vec3 E = normalize(-pos);   // Direction to the eye/camera
 
-    //---------
-    // Light 1
-    //---------
+    vec3 ambient = Ambient * MaterialColor * AmbientLight;
+    vec3 diffuse = vec3(0.0, 0.0, 0.0);
+    vec3 specular = vec3(0.0, 0.0, 0.0);
 
-    // The vector to the light from the vertex
-    vec3 Lvec1 = LightPosition1.xyz - pos;
+    //--------------------
+    // Directional lights
+    //--------------------
 
-    float Ldist1 = length(Lvec1); // Distance from light source
-    float Lscale1 = 1.0 / (Ldist1 * Ldist1); // Light scaling factor
+    for (int i = 0; i < NumDirLights; i++) {
+        vec3 L = normalize(texelFetch(LightData, i*2).xyz);  // Direction to the light source
+        vec3 lightColor = texelFetch(LightData, i*2 + 1).rgb;
 
-    vec3 L1 = normalize(Lvec1);   // Direction to the light source
-    vec3 H1 = normalize(L1 + E);  // Halfway vector
+        // No specular term, as with the baseline's directional light.
+        float Kd = max(dot(L, N), 0.0);
+        diffuse += Kd * Diffuse * MaterialColor * lightColor;
+    }
 
-    // Compute terms in the illumination equation
-    vec3 ambient1 = AmbientProduct1;
+    //-------------------------------
+    // Point lights for this cluster
+    //-------------------------------
 
-    float Kd1 = max(dot(L1, N), 0.0);
-    vec3  diffuse1 = Kd1 * DiffuseProduct1 * Lscale1;
+    ivec2 tile = ivec2(gl_FragCoord.xy / ScreenSize * vec2(ClusterDims.xy));
+    int slice = int(floor(log(-pos.z / ClusterDepth.x) * ClusterDepth.y));
+    ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), ClusterDims - 1);
+    uvec2 range = texelFetch(ClusterGrid,
+                             cluster.x + ClusterDims.x * (cluster.y + ClusterDims.y * cluster.z)).xy;
 
-    float Ks1 = pow(max(dot(N, H1), 0.0), Shininess);
-    float Si1 = dot(SpecularProduct1, vec3(0.33, 0.33, 0.33));
-    vec3  specular1 = Ks1 * vec3(Si1, Si1, Si1) * Lscale1;
-    
-    if( dot(L1, N) < 0.0 ) {
-      specular1 = vec3(0.0, 0.0, 0.0);
-    }
+    for (uint j = 0u; j < range.y; j++) {
+        int i = int(texelFetch(LightIndices, int(range.x + j)).r);
+        vec4 lightPos = texelFetch(LightData, i*2);
+        vec4 lightColor = texelFetch(LightData, i*2 + 1);
+
+        // The vector to the light from the vertex
+        vec3 Lvec = lightPos.xyz - pos;
 
-    //---------
-    // Light 2
-    //---------
+        float Ldist = length(Lvec); // Distance from light source
 
-    // The vector to the light from the origin
-    vec3 Lvec2 = (LightPosition2 - (View * vec4(0.0, 0.0, 0.0, 1.0))).xyz;
+        // Light scaling factor.  Reaches zero at the light's range, which is where
+        // the 1/d^2 falloff is already too dim to see.
+        float Lscale = max(1.0 / (Ldist * Ldist) - 1.0 / (lightColor.a * lightColor.a), 0.0);
 
-    // float Ldist2 = length(Lvec2); // Distance from light source
-    // float Lscale2 = 1.0 / (Ldist2 * Ldist2); // Light scaling factor
+        // Ambient light fades out over the same range, from full at the light.
+        float ambientScale = max(1.0 - (Ldist * Ldist) / (lightColor.a * lightColor.a), 0.0);
 
-    vec3 L2 = normalize(Lvec2);   // Direction to the light source
-    vec3 H2 = normalize(L2);  // Halfway vector
+        vec3 L = normalize(Lvec);   // Direction to the light source
+        vec3 H = normalize(L + E);  // Halfway vector
 
-    // Compute terms in the illumination equation
-    vec3 ambient2 = AmbientProduct2;
+        // Compute terms in the illumination equation
+        ambient += Ambient * MaterialColor * lightColor.rgb * ambientScale;
 
-    float Kd2 = max(dot(L2, N), 0.0);
-    vec3  diffuse2 = Kd2 * DiffuseProduct2; // * Lscale2;
+        float Kd = max(dot(L, N), 0.0);
+        diffuse += Kd * Diffuse * MaterialColor * lightColor.rgb * Lscale;
 
-    float Ks2 = pow(max(dot(N, H2), 0.0), Shininess);
-    float Si2 = dot(SpecularProduct2, vec3(0.33, 0.33, 0.33));
-    vec3  specular2 = Ks2 * vec3(Si2, Si2, Si2); // * Lscale2;
-    
-    if( dot(L2, N) < 0.0 ) {
-      specular2 = vec3(0.0, 0.0, 0.0);
+        float Ks = pow(max(dot(N, H), 0.0), Shininess);
+        float Si = dot(Specular * MaterialColor * lightColor.rgb, vec3(0.33, 0.33, 0.33));
+        if( dot(L, N) >= 0.0 ) {
+          specular += Ks * vec3(Si, Si, Si) * Lscale;
+        }
     }
 
     vec4 color;
 
-    color.rgb = globalAmbient + ambient1 + diffuse1 + ambient2 + diffuse2;
+    color.rgb = globalAmbient + ambient + diffuse;
     color.a = 1.0;
 
+#ifdef TEXTURED
     fColor = color * texture2D( texture, texCoord * texScale );
-    fColor.rgb = fColor.rgb + specular1;
+#else
+    fColor = color;
+#endif
+    fColor.rgb = fColor.rgb + specular;
+#ifdef ALPHA
     fColor.a = Alpha;
+#else
+    fColor.a = 1.0;
+#endif
 }
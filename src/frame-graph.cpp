@@ -0,0 +1,79 @@
+#include "frame-graph.h"
+#include "frame-stats.h"
+#include "Angel.h"
+
+#include <vector>
+
+static GLuint program, vao, vbo;
+static GLint screenSizeU;
+
+static std::vector<GLfloat> vertices;  // x, y, r, g, b for each end of each line
+
+static const float left = 10.0, bottom = 10.0;
+static const float pixelsPerFrame = 2.0;
+static const float pixelsPerMs = 3.0;
+static const float maxMs = 50.0;   // Taller bars are cut off
+
+static void addLine(float x0, float y0, float x1, float y1, vec3 color) {
+    GLfloat line[10] = { x0, y0, color.x, color.y, color.z, x1, y1, color.x, color.y, color.z };
+    vertices.insert(vertices.end(), line, line + 10);
+}
+
+static float heightOf(double ms) {
+    return (ms < maxMs ? ms : maxMs) * pixelsPerMs;
+}
+
+void initFrameGraph() {
+    program = InitShader("src/vGraph.glsl", "src/fGraph.glsl");
+    screenSizeU = glGetUniformLocation(program, "ScreenSize");
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    GLuint vPixel = glGetAttribLocation(program, "vPixel");
+    GLuint vColor = glGetAttribLocation(program, "vColor");
+    glEnableVertexAttribArray(vPixel);
+    glVertexAttribPointer(vPixel, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), BUFFER_OFFSET(0));
+    glEnableVertexAttribArray(vColor);
+    glVertexAttribPointer(vColor, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
+                          BUFFER_OFFSET(2 * sizeof(GLfloat)));
+    glBindVertexArray(0);
+    CheckError();
+}
+
+void drawFrameGraph(int windowWidth, int windowHeight) {
+    vertices.clear();
+
+    int n = frameHistoryCount();
+    float right = left + frameHistorySize * pixelsPerFrame;
+
+    // Reference lines at 60 and 30 frames per second.
+    addLine(left, bottom + heightOf(1000.0/60.0), right, bottom + heightOf(1000.0/60.0), vec3(0.4, 0.4, 0.4));
+    addLine(left, bottom + heightOf(1000.0/30.0), right, bottom + heightOf(1000.0/30.0), vec3(0.4, 0.4, 0.4));
+
+    for (int i = 0; i < n; i++) {
+        const FrameStats& f = frameHistory(i);
+        float x = left + i * pixelsPerFrame;
+        vec3 color = f.frameMs <= 1000.0/60.0 ? vec3(0.2, 0.8, 0.2)
+                   : f.frameMs <= 1000.0/30.0 ? vec3(0.9, 0.8, 0.2) : vec3(0.9, 0.2, 0.2);
+        addLine(x, bottom, x, bottom + heightOf(f.frameMs), color);
+
+        if (i > 0 && f.gpuMs >= 0.0 && frameHistory(i-1).gpuMs >= 0.0)
+            addLine(x - pixelsPerFrame, bottom + heightOf(frameHistory(i-1).gpuMs),
+                    x, bottom + heightOf(f.gpuMs), vec3(0.3, 0.7, 1.0));
+    }
+
+    glUseProgram(program);
+    glUniform2f(screenSizeU, windowWidth, windowHeight);
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STREAM_DRAW);
+
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_LINES, 0, vertices.size() / 5);
+    glEnable(GL_DEPTH_TEST);
+    CheckError();
+}
@@ -0,0 +1,16 @@
+// ------ Frame-time graph --------------------------------------------------------
+//
+// An overlay in the bottom-left corner showing the recent frames from
+// frame-stats.h: a bar of CPU time per frame, coloured by whether it made 60
+// or 30 frames per second, with the GPU time drawn as a line over the bars.
+
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+// Load the graph's shaders.  Needs a GL context.
+void initFrameGraph();
+
+// Draw the graph over the current frame.
+void drawFrameGraph(int windowWidth, int windowHeight);
+
+#endif // FRAME_GRAPH_H
@@ -0,0 +1,135 @@
+#include "frame-pacer.h"
+#include "Angel.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef __APPLE__
+#  include <GL/glx.h>
+
+typedef void (*PFNSWAPINTERVALEXT)(Display* dpy, GLXDrawable drawable, int interval);
+typedef int (*PFNSWAPINTERVALMESA)(unsigned interval);
+typedef int (*PFNSWAPINTERVALSGI)(int interval);
+#endif
+
+// The swap-interval extensions, best first.  SGI's can't turn vsync off.
+enum { SWAP_NONE, SWAP_EXT, SWAP_MESA, SWAP_SGI };
+
+static int swapControl = SWAP_NONE;
+static void* swapInterval = NULL;
+
+static bool vsyncOn = true;
+static bool explicitTarget = false;
+static double targetFps = 60.0;  // Used for vsync when there's no swap control
+static double deadline = 0.0;    // When the next frame may start
+
+static double lastCpuTime = 0.0, lastWallTime = 0.0;
+
+static double secondsOn(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double monotonicSeconds() {
+    return secondsOn(CLOCK_MONOTONIC);
+}
+
+void sleepUntilSeconds(double when) {
+    struct timespec ts;
+    ts.tv_sec = (time_t) when;
+    ts.tv_nsec = (long) ((when - ts.tv_sec) * 1e9);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;  // Interrupted by a signal - go back to sleep
+}
+
+#ifndef __APPLE__
+static bool hasGLXExtension(Display* dpy, const char* name) {
+    const char* exts = glXQueryExtensionsString(dpy, DefaultScreen(dpy));
+    size_t len = strlen(name);
+    for(const char* p = exts; p != NULL && (p = strstr(p, name)) != NULL; p += len)
+        if((p == exts || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+            return true;
+    return false;
+}
+#endif
+
+void initFramePacer() {
+#ifndef __APPLE__
+    Display* dpy = glXGetCurrentDisplay();
+    if(dpy == NULL) return;  // Not a GLX context
+
+    if(hasGLXExtension(dpy, "GLX_EXT_swap_control")) {
+        swapControl = SWAP_EXT;
+        swapInterval = (void*) glXGetProcAddressARB((const GLubyte*) "glXSwapIntervalEXT");
+    } else if(hasGLXExtension(dpy, "GLX_MESA_swap_control")) {
+        swapControl = SWAP_MESA;
+        swapInterval = (void*) glXGetProcAddressARB((const GLubyte*) "glXSwapIntervalMESA");
+    } else if(hasGLXExtension(dpy, "GLX_SGI_swap_control")) {
+        swapControl = SWAP_SGI;
+        swapInterval = (void*) glXGetProcAddressARB((const GLubyte*) "glXSwapIntervalSGI");
+    }
+    if(swapInterval == NULL) swapControl = SWAP_NONE;
+#endif
+
+    lastCpuTime = secondsOn(CLOCK_PROCESS_CPUTIME_ID);
+    lastWallTime = monotonicSeconds();
+    setFramePacerVsync(vsyncOn);
+}
+
+void setFramePacerVsync(bool on) {
+    vsyncOn = on;
+#ifndef __APPLE__
+    if(swapControl == SWAP_EXT)
+        ((PFNSWAPINTERVALEXT) swapInterval)(glXGetCurrentDisplay(), glXGetCurrentDrawable(), on ? 1 : 0);
+    else if(swapControl == SWAP_MESA)
+        ((PFNSWAPINTERVALMESA) swapInterval)(on ? 1 : 0);
+    else if(swapControl == SWAP_SGI && on)
+        ((PFNSWAPINTERVALSGI) swapInterval)(1);
+#endif
+    deadline = 0.0;
+}
+
+bool framePacerHasSwapControl() {
+    return swapControl != SWAP_NONE;
+}
+
+void setFramePacerTarget(double fps) {
+    targetFps = fps > 0.0 ? fps : 0.0;
+    explicitTarget = true;
+    deadline = 0.0;
+}
+
+double framePacerTarget() {
+    return targetFps;
+}
+
+void waitForNextFrame() {
+    // With swap control the driver blocks in SwapBuffers, and with vsync off
+    // frames are drawn as fast as possible, unless a target was asked for.
+    bool swapPaced = vsyncOn && swapControl != SWAP_NONE;
+    bool sleeping = targetFps > 0.0 && (explicitTarget || (vsyncOn && !swapPaced));
+    if(!sleeping) return;
+
+    double period = 1.0 / targetFps;
+    double now = monotonicSeconds();
+
+    // If we've fallen more than a frame behind, start afresh rather than
+    // drawing a burst of frames to catch up.
+    if(deadline == 0.0 || now - deadline > period)
+        deadline = now;
+    else if(now < deadline)
+        sleepUntilSeconds(deadline);
+
+    deadline += period;
+}
+
+double framePacerCpuPercent() {
+    double cpu = secondsOn(CLOCK_PROCESS_CPUTIME_ID);
+    double wall = monotonicSeconds();
+    double percent = wall > lastWallTime ? 100.0 * (cpu - lastCpuTime) / (wall - lastWallTime) : 0.0;
+    lastCpuTime = cpu;
+    lastWallTime = wall;
+    return percent;
+}
@@ -0,0 +1,38 @@
+// ------ Frame pacing ----------------------------------------------------------
+//
+// Frames are paced by the driver's swap interval (GLX_EXT_swap_control or one
+// of its relatives) when vsync is on and the platform offers it.  Otherwise,
+// or when a target frame rate has been asked for explicitly, the idle callback
+// sleeps until the next frame's deadline on the monotonic clock rather than
+// spinning, so an idle window costs next to no CPU.
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+// Seconds on a monotonic clock, from an arbitrary starting point.
+double monotonicSeconds();
+
+// Sleep until the monotonic clock reaches the given time.
+void sleepUntilSeconds(double when);
+
+// Look up the swap-interval extension.  Needs a current GL context.
+void initFramePacer();
+
+// Turn vsync on or off, via the swap interval if there is one.
+void setFramePacerVsync(bool on);
+
+// True if vsync is driven by the swap interval rather than by sleeping.
+bool framePacerHasSwapControl();
+
+// Frames per second to aim for; 0 for no limit.  Setting this explicitly makes
+// the pacer sleep to it even when the swap interval is also in effect.
+void setFramePacerTarget(double fps);
+double framePacerTarget();
+
+// Sleep until it's time to start the next frame.  Call before each redisplay.
+void waitForNextFrame();
+
+// Percentage of one core used by the process since the last call.
+double framePacerCpuPercent();
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,110 @@
+#include "frame-stats.h"
+#include "frame-pacer.h"
+#include "Angel.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const char* frameStageNames[numFrameStages] = {
+    "input", "simulation", "lights", "culling", "animation", "uniforms", "draw", "swap"
+};
+
+FrameStats frameStats;
+
+static double frameStart = 0.0;
+
+static FrameStats history[frameHistorySize];
+static long framesRecorded = 0;
+
+static bool gpuTimers = false;
+static GLuint gpuQueries[2];
+static long gpuQueryFrame[2] = { -1, -1 };  // The frame each query is timing
+
+void initFrameStats() {
+    memset(&frameStats, 0, sizeof frameStats);
+    gpuTimers = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (gpuTimers)
+        glGenQueries(2, gpuQueries);
+}
+
+void beginFrameStats() {
+    frameStart = monotonicSeconds();
+    frameStats.gpuMs = -1.0;
+
+    if (gpuTimers) {
+        // Collect the result from two frames ago before reusing its query.
+        int q = framesRecorded % 2;
+        long frame = gpuQueryFrame[q];
+        if (frame >= 0 && frame >= framesRecorded - frameHistorySize) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(gpuQueries[q], GL_QUERY_RESULT, &ns);
+            history[frame % frameHistorySize].gpuMs = ns / 1e6;
+        }
+        gpuQueryFrame[q] = framesRecorded;
+        glBeginQuery(GL_TIME_ELAPSED, gpuQueries[q]);
+    }
+}
+
+void endFrameStats() {
+    if (gpuTimers)
+        glEndQuery(GL_TIME_ELAPSED);
+
+    frameStats.frameMs = (monotonicSeconds() - frameStart) * 1000.0;
+    history[framesRecorded % frameHistorySize] = frameStats;
+    framesRecorded++;
+
+    memset(&frameStats, 0, sizeof frameStats);
+}
+
+int frameHistoryCount() {
+    return framesRecorded < frameHistorySize ? framesRecorded : frameHistorySize;
+}
+
+const FrameStats& frameHistory(int i) {
+    return history[(framesRecorded - frameHistoryCount() + i) % frameHistorySize];
+}
+
+const FrameStats& lastFrameStats() {
+    return history[(framesRecorded + frameHistorySize - 1) % frameHistorySize];
+}
+
+bool writeFrameStatsCsv(const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL)
+        return false;
+
+    fprintf(fp, "frame,frame_ms,gpu_ms");
+    for (int s = 0; s < numFrameStages; s++)
+        fprintf(fp, ",%s_ms", frameStageNames[s]);
+    fprintf(fp, ",draw_calls,triangles\n");
+
+    long first = framesRecorded - frameHistoryCount();
+    for (int i = 0; i < frameHistoryCount(); i++) {
+        const FrameStats& f = frameHistory(i);
+        fprintf(fp, "%ld,%.4f,%.4f", first + i, f.frameMs, f.gpuMs);
+        for (int s = 0; s < numFrameStages; s++)
+            fprintf(fp, ",%.4f", f.stageMs[s]);
+        fprintf(fp, ",%d,%d\n", f.drawCalls, f.triangles);
+    }
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
+
+static StageTimer* innermost = NULL;
+
+StageTimer::StageTimer(FrameStage stage)
+    : stage(stage), start(monotonicSeconds()), outer(innermost), zone(frameStageNames[stage]) {
+    if (outer != NULL)
+        frameStats.stageMs[outer->stage] += (start - outer->start) * 1000.0;
+    innermost = this;
+}
+
+StageTimer::~StageTimer() {
+    double now = monotonicSeconds();
+    frameStats.stageMs[stage] += (now - start) * 1000.0;
+    innermost = outer;
+    if (outer != NULL)
+        outer->start = now;  // Resume the interrupted stage
+}
@@ -0,0 +1,75 @@
+// ------ Frame statistics ------------------------------------------------------
+//
+// Each frame records the CPU time spent in each stage of display(), along with
+// the number of draw calls and triangles submitted.  Stages are timed with a
+// StageTimer for the duration of a scope; time in the same stage adds up.  A
+// timer started inside another pauses it, so each stage's time is exclusive.
+// Timers are for the drawing thread only.  Input handled between two frames
+// counts towards the second.
+//
+// GPU time comes from GL_TIME_ELAPSED queries.  There are two, used on
+// alternate frames, so a frame's result is read two frames later when it's
+// long since available, rather than stalling for it.
+//
+// The last frameHistorySize frames are kept for the frame graph and can be
+// written out as CSV.
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include "trace.h"
+
+enum FrameStage {
+    STAGE_INPUT,        // Keyboard and mouse callbacks
+    STAGE_SIMULATION,   // Stepping and sampling the simulation
+    STAGE_LIGHTS,       // Gathering and binning lights
+    STAGE_CULLING,      // Choosing the objects to draw
+    STAGE_ANIMATION,    // Calculating bone poses
+    STAGE_UNIFORMS,     // Setting uniforms and binding textures and VAOs
+    STAGE_DRAW,         // Draw calls
+    STAGE_SWAP,         // Swapping buffers (or finishing, when headless)
+    numFrameStages
+};
+
+extern const char* frameStageNames[numFrameStages];
+
+typedef struct {
+    double frameMs;                  // The whole display() call
+    double stageMs[numFrameStages];
+    double gpuMs;                    // -1 until the GPU timer's result arrives
+    int drawCalls;
+    int triangles;
+} FrameStats;
+
+extern FrameStats frameStats;  // The frame being drawn
+
+const int frameHistorySize = 240;
+
+// Create the GPU timer queries, if the context has them.
+void initFrameStats();
+
+// Mark the start and end of a frame.  The end records the frame in the history
+// and starts afresh for the next one.
+void beginFrameStats();
+void endFrameStats();
+
+// The recorded frames, oldest first.
+int frameHistoryCount();
+const FrameStats& frameHistory(int i);
+const FrameStats& lastFrameStats();
+
+// Write the history as CSV, one row per frame.  Returns false if the file can't be written.
+bool writeFrameStatsCsv(const char* filename);
+
+class StageTimer {
+public:
+    StageTimer(FrameStage stage);
+    ~StageTimer();
+private:
+    FrameStage stage;
+    double start;
+    StageTimer* outer;  // The timer this one interrupted, if any
+    TraceZone zone;     // Stages also show up in traces
+};
+
+#endif // FRAME_STATS_H
@@ -0,0 +1,68 @@
+#include "gl-extra.h"
+
+#include <string.h>
+
+#ifndef __APPLE__
+#  include <EGL/egl.h>
+#endif
+
+PFNGETPROGRAMBINARY glExtGetProgramBinary = NULL;
+PFNPROGRAMBINARY glExtProgramBinary = NULL;
+PFNPROGRAMPARAMETERI glExtProgramParameteri = NULL;
+PFNMAXSHADERCOMPILERTHREADS glExtMaxShaderCompilerThreads = NULL;
+PFNDEBUGMESSAGECALLBACK glExtDebugMessageCallback = NULL;
+PFNDEBUGMESSAGECONTROL glExtDebugMessageControl = NULL;
+
+bool glExtHasProgramBinary = false;
+bool glExtHasParallelCompile = false;
+
+static void* getProc(const char* name) {
+#ifndef __APPLE__
+    if (eglGetCurrentContext() != EGL_NO_CONTEXT)  // Headless, without GLUT
+        return (void*) eglGetProcAddress(name);
+#endif
+    return (void*) glutGetProcAddress(name);
+}
+
+bool hasGLExtension(const char* name) {
+    GLint n = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+    for(GLint i=0; i<n; i++) {
+        const char* ext = (const char*) glGetStringi(GL_EXTENSIONS, i);
+        if(ext != NULL && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void loadGLExtra() {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool gl41 = major > 4 || (major == 4 && minor >= 1);
+
+    if(gl41 || hasGLExtension("GL_ARB_get_program_binary")) {
+        glExtGetProgramBinary = (PFNGETPROGRAMBINARY) getProc("glGetProgramBinary");
+        glExtProgramBinary = (PFNPROGRAMBINARY) getProc("glProgramBinary");
+        glExtProgramParameteri = (PFNPROGRAMPARAMETERI) getProc("glProgramParameteri");
+
+        // A driver may expose the entry points but support no binary formats at all.
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        glExtHasProgramBinary = glExtGetProgramBinary && glExtProgramBinary
+                                && glExtProgramParameteri && formats > 0;
+    }
+
+    if(hasGLExtension("GL_KHR_parallel_shader_compile"))
+        glExtMaxShaderCompilerThreads = (PFNMAXSHADERCOMPILERTHREADS) getProc("glMaxShaderCompilerThreadsKHR");
+    else if(hasGLExtension("GL_ARB_parallel_shader_compile"))
+        glExtMaxShaderCompilerThreads = (PFNMAXSHADERCOMPILERTHREADS) getProc("glMaxShaderCompilerThreadsARB");
+    glExtHasParallelCompile = glExtMaxShaderCompilerThreads != NULL;
+
+    if(major > 4 || (major == 4 && minor >= 3) || hasGLExtension("GL_KHR_debug")) {
+        glExtDebugMessageCallback = (PFNDEBUGMESSAGECALLBACK) getProc("glDebugMessageCallback");
+        glExtDebugMessageControl = (PFNDEBUGMESSAGECONTROL) getProc("glDebugMessageControl");
+    }
+
+    CheckError(); // Querying an unknown extension is harmless, but report anything else.
+}
@@ -0,0 +1,77 @@
+// ------ Extra OpenGL entry points ------------------------------------------
+//
+// The glew.h copy in include/GL predates several extensions that we use when
+// the driver offers them.  Their tokens and function pointers are declared
+// here and filled in by loadGLExtra() after the context has been created.
+// Every pointer may be NULL - always test hasGLExtension() or the pointer.
+
+#ifndef GL_EXTRA_H
+#define GL_EXTRA_H
+
+#include "Angel.h"
+
+// GL_ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#  define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#  define GL_PROGRAM_BINARY_LENGTH           0x8741
+#  define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+#endif
+
+// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#  define GL_COMPLETION_STATUS_KHR           0x91B1
+#endif
+
+// GL_KHR_debug (core in 4.3)
+#ifndef GL_DEBUG_OUTPUT
+#  define GL_DEBUG_OUTPUT                    0x92E0
+#  define GL_DEBUG_OUTPUT_SYNCHRONOUS        0x8242
+#  define GL_CONTEXT_FLAG_DEBUG_BIT          0x00000002
+#  define GL_DEBUG_SOURCE_API                0x8246
+#  define GL_DEBUG_SOURCE_WINDOW_SYSTEM      0x8247
+#  define GL_DEBUG_SOURCE_SHADER_COMPILER    0x8248
+#  define GL_DEBUG_SOURCE_THIRD_PARTY        0x8249
+#  define GL_DEBUG_SOURCE_APPLICATION        0x824A
+#  define GL_DEBUG_SOURCE_OTHER              0x824B
+#  define GL_DEBUG_TYPE_ERROR                0x824C
+#  define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR  0x824D
+#  define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR   0x824E
+#  define GL_DEBUG_TYPE_PORTABILITY          0x824F
+#  define GL_DEBUG_TYPE_PERFORMANCE          0x8250
+#  define GL_DEBUG_TYPE_OTHER                0x8251
+#  define GL_DEBUG_SEVERITY_HIGH             0x9146
+#  define GL_DEBUG_SEVERITY_MEDIUM           0x9147
+#  define GL_DEBUG_SEVERITY_LOW              0x9148
+#  define GL_DEBUG_SEVERITY_NOTIFICATION     0x826B
+#endif
+
+typedef void (GLAPIENTRY *PFNGETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                             GLenum *binaryFormat, void *binary);
+typedef void (GLAPIENTRY *PFNPROGRAMBINARY)(GLuint program, GLenum binaryFormat,
+                                          const void *binary, GLsizei length);
+typedef void (GLAPIENTRY *PFNPROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+typedef void (GLAPIENTRY *PFNMAXSHADERCOMPILERTHREADS)(GLuint count);
+typedef void (GLAPIENTRY *GLEXTDEBUGPROC)(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                          GLsizei length, const GLchar *message, const void *userParam);
+typedef void (GLAPIENTRY *PFNDEBUGMESSAGECALLBACK)(GLEXTDEBUGPROC callback, const void *userParam);
+typedef void (GLAPIENTRY *PFNDEBUGMESSAGECONTROL)(GLenum source, GLenum type, GLenum severity,
+                                                  GLsizei count, const GLuint *ids, GLboolean enabled);
+
+extern PFNGETPROGRAMBINARY glExtGetProgramBinary;
+extern PFNPROGRAMBINARY glExtProgramBinary;
+extern PFNPROGRAMPARAMETERI glExtProgramParameteri;
+extern PFNMAXSHADERCOMPILERTHREADS glExtMaxShaderCompilerThreads;
+extern PFNDEBUGMESSAGECALLBACK glExtDebugMessageCallback;
+extern PFNDEBUGMESSAGECONTROL glExtDebugMessageControl;
+
+// Set once loadGLExtra() has run.
+extern bool glExtHasProgramBinary;
+extern bool glExtHasParallelCompile;
+
+// Look up the entry points above.  Call once, with the context current.
+void loadGLExtra();
+
+// True if the current context lists the named extension (uses glGetStringi).
+bool hasGLExtension(const char* name);
+
+#endif // GL_EXTRA_H
@@ -38,7 +38,10 @@ texture* loadTexture(char *fileName) {
     texture* t = (texture*) malloc(sizeof (texture)); 
     BITMAPINFO *info;
 
-    t->rgbData = LoadDIBitmap(fileName, &info);
+    {
+        TraceZone zone("LoadDIBitmap");  // Added: shows up in traces (trace.h)
+        t->rgbData = LoadDIBitmap(fileName, &info);
+    }
     if(t->rgbData == NULL) fail("Error loading image: ", fileName);
        
     t->height=info->bmiHeader.biHeight;
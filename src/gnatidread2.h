@@ -6,19 +6,37 @@
 
 // Load a model's scene by number from the models-textures directory via the Open Asset Importer
 const aiScene* loadScene(int meshNumber) {
+        TraceZone zone("loadScene");  // Added: shows up in traces (trace.h)
         char filename[256];
         sprintf(filename, "%s/model%d.x", dataDir, meshNumber);
         return aiImportFile(filename, aiProcessPreset_TargetRealtime_MaxQuality);
 }
 
+// Added: as loadScene, but parsing the file and post-processing it as separate steps so each
+// can be timed (for --import-bench).  Returns NULL if either step fails.
+const aiScene* loadSceneInSteps(int meshNumber, double* parseMs, double* postMs) {
+        char filename[256];
+        sprintf(filename, "%s/model%d.x", dataDir, meshNumber);
+        double start = monotonicSeconds();
+        const aiScene* scene = aiImportFile(filename, 0);
+        double parsed = monotonicSeconds();
+        if(scene != NULL)
+            scene = aiApplyPostProcessing(scene, aiProcessPreset_TargetRealtime_MaxQuality);
+        *parseMs = (parsed - start) * 1000.0;
+        *postMs = (monotonicSeconds() - parsed) * 1000.0;
+        return scene;
+}
+
 // Extract the boneIDs and boneWeights for the bones affecting each vertex in a mesh.  
 // Each vertex has up to 4 bones - if there are more than 4, lower weighted bones are omitted.  
 void getBonesAffectingEachVertex(aiMesh* mesh, GLint boneIDs[][4], GLfloat boneWeights[][4]) {
 
     // Initialize weights to 0.0
     for(unsigned int i=0; i < mesh->mNumVertices; i++)
-        for(int j=0; j<4; j++)  
+        for(int j=0; j<4; j++) {
             boneWeights[i][j] = 0.0;
+            boneIDs[i][j] = 0;  // Added: unused slots still index the palette, so point them at bone 0
+        }
 
     if(mesh->mNumBones == 0) {  // No bones, so just use a single matrix (which should be the identity)
         for(unsigned int i=0; i < mesh->mNumVertices; i++) {
@@ -47,6 +65,16 @@ void getBonesAffectingEachVertex(aiMesh* mesh, GLint boneIDs[][4], GLfloat boneW
 	    }  
 }
 
+// Added: copy the triangle vertex indices of a mesh into elements, which needs space for
+// 3*mNumFaces.  Split out of loadMeshIfNotAlreadyLoaded so perf/perftest.cpp can time it.
+void getFaceIndices(aiMesh* mesh, GLuint elements[]) {
+    for(GLuint i=0; i < mesh->mNumFaces; i++) {
+        elements[i*3] = mesh->mFaces[i].mIndices[0];
+        elements[i*3+1] = mesh->mFaces[i].mIndices[1];
+        elements[i*3+2] = mesh->mFaces[i].mIndices[2];
+    }
+}
+
 // Parts of the following are broadly based on:
 //     http://sourceforge.net/projects/assimp/forums/forum/817654/topic/3880745
 //     http://ogldev.atspace.co.uk/www/tutorial38/tutorial38.html
@@ -54,6 +82,7 @@ void getBonesAffectingEachVertex(aiMesh* mesh, GLint boneIDs[][4], GLfloat boneW
 // calculateAnimPose calculates the bone transformations for a mesh at a particular time in an animation (in scene)
 // Each bone transformation is relative to the rest pose.
 void calculateAnimPose(aiMesh* mesh, const aiScene* scene, int animNum, float poseTime, mat4 *boneTransforms) {
+    TraceZone zone("calculateAnimPose");  // Added: shows up in traces (trace.h)
 
     if(mesh->mNumBones == 0 || animNum < 0) {    // animNum = -1 for no animation
         boneTransforms[0] = mat4(1.0);           // so, just return a single identity matrix
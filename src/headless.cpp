@@ -0,0 +1,140 @@
+#include "headless.h"
+#include "Angel.h"
+#include "bitmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef __APPLE__
+#  include <EGL/egl.h>
+#  include <EGL/eglext.h>
+#endif
+
+static int fboWidth = 0, fboHeight = 0;
+
+#ifndef __APPLE__
+static EGLDisplay openDisplay() {
+    // Prefer the surfaceless platform, which needs neither X nor a GPU device node.
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    if (getPlatformDisplay != NULL)
+        dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (dpy == EGL_NO_DISPLAY)
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    return dpy;
+}
+
+static bool createContext() {
+    EGLDisplay dpy = openDisplay();
+    EGLint major, minor;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor)) {
+        fprintf(stderr, "Headless: no EGL display\n");
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "Headless: EGL %d.%d has no desktop OpenGL\n", major, minor);
+        return false;
+    }
+
+    // With no surface the config hardly matters; the surfaceless platform offers none.
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    const char* exts = eglQueryString(dpy, EGL_EXTENSIONS);
+    if (exts == NULL || strstr(exts, "EGL_KHR_no_config_context") == NULL) {
+        const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLint numConfigs = 0;
+        if (!eglChooseConfig(dpy, configAttribs, &config, 1, &numConfigs) || numConfigs < 1) {
+            fprintf(stderr, "Headless: no EGL config for OpenGL\n");
+            return false;
+        }
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 2,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+#ifndef NDEBUG
+        EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,  // For GL debug output
+#endif
+        EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx == EGL_NO_CONTEXT) {
+        fprintf(stderr, "Headless: couldn't create an OpenGL 3.2 context (EGL error 0x%x)\n", eglGetError());
+        return false;
+    }
+
+    // No surface at all: drawing goes to the framebuffer object.
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        fprintf(stderr, "Headless: EGL_KHR_surfaceless_context is needed (EGL error 0x%x)\n", eglGetError());
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool initHeadless(int width, int height) {
+#ifdef __APPLE__
+    fprintf(stderr, "Headless rendering needs EGL, which isn't available on this platform\n");
+    return false;
+#else
+    if (!createContext())
+        return false;
+
+    // glewInit loads the entry points through GLX; it may report that there's no
+    // GLX display, but the core functions it needs are loaded by then.
+    glewInit();
+    glGetError();  // Discard anything glewInit left behind
+
+    GLuint fbo, renderbuffers[2];
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(2, renderbuffers);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Headless: framebuffer incomplete (0x%x)\n", status);
+        return false;
+    }
+    CheckError();
+
+    fboWidth = width;
+    fboHeight = height;
+    printf("Headless: %dx%d, %s\n", width, height, glGetString(GL_RENDERER));
+    return true;
+#endif
+}
+
+void saveHeadlessFrame(const char* filename) {
+    // BMP rows are padded to 4 bytes, which is also GL's default pack alignment.
+    int rowLength = (fboWidth * 3 + 3) & ~3;
+    GLubyte* bits = (GLubyte*) malloc(rowLength * fboHeight);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, fboWidth, fboHeight, GL_RGB, GL_UNSIGNED_BYTE, bits);
+    CheckError();
+
+    BITMAPINFO info;
+    memset(&info, 0, sizeof info);
+    info.bmiHeader.biSize = 40;
+    info.bmiHeader.biWidth = fboWidth;
+    info.bmiHeader.biHeight = fboHeight;   // Bottom-up, as glReadPixels returns it
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 24;
+    info.bmiHeader.biCompression = BI_RGB;
+    info.bmiHeader.biSizeImage = rowLength * fboHeight;
+
+    if (SaveDIBitmap(filename, &info, bits) != 0)
+        fprintf(stderr, "Headless: couldn't write %s\n", filename);
+    free(bits);
+}
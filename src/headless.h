@@ -0,0 +1,17 @@
+// ------ Headless rendering ----------------------------------------------------
+//
+// For machines without a display: an EGL context is created on Mesa's
+// surfaceless platform (llvmpipe works without a GPU) and everything is drawn
+// into a framebuffer object of the requested size instead of a window.
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Create and make current a GL 3.2 compatibility context with a width x height
+// framebuffer bound for drawing.  Prints why and returns false if it can't.
+bool initHeadless(int width, int height);
+
+// Read back the framebuffer and write it as a .bmp file.
+void saveHeadlessFrame(const char* filename);
+
+#endif // HEADLESS_H
@@ -0,0 +1,106 @@
+#include "import-bench.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+static double totalMs(const AssetStats& a) {
+    return a.parseMs + a.postMs + a.uploadMs;
+}
+
+// Models before textures, then by number, rather than model10 before model2.
+static bool byName(const AssetStats& a, const AssetStats& b) {
+    if (a.isMesh != b.isMesh) return a.isMesh;
+    int na = atoi(a.name + strcspn(a.name, "0123456789"));
+    int nb = atoi(b.name + strcspn(b.name, "0123456789"));
+    return na < nb;
+}
+
+#define LARGEST_FIRST(field) \
+    [](const AssetStats& a, const AssetStats& b) { return a.field > b.field; }
+
+bool sortAssetStats(vector<AssetStats>& assets, const char* column) {
+    if (strcmp(column, "name") == 0)
+        stable_sort(assets.begin(), assets.end(), byName);
+    else if (strcmp(column, "parse") == 0)
+        stable_sort(assets.begin(), assets.end(), LARGEST_FIRST(parseMs));
+    else if (strcmp(column, "post") == 0)
+        stable_sort(assets.begin(), assets.end(), LARGEST_FIRST(postMs));
+    else if (strcmp(column, "upload") == 0)
+        stable_sort(assets.begin(), assets.end(), LARGEST_FIRST(uploadMs));
+    else if (strcmp(column, "total") == 0)
+        stable_sort(assets.begin(), assets.end(),
+                    [](const AssetStats& a, const AssetStats& b) { return totalMs(a) > totalMs(b); });
+    else if (strcmp(column, "vertices") == 0)
+        stable_sort(assets.begin(), assets.end(), LARGEST_FIRST(vertices));
+    else if (strcmp(column, "faces") == 0)
+        stable_sort(assets.begin(), assets.end(), LARGEST_FIRST(faces));
+    else if (strcmp(column, "bones") == 0)
+        stable_sort(assets.begin(), assets.end(), LARGEST_FIRST(bones));
+    else if (strcmp(column, "cpu") == 0)
+        stable_sort(assets.begin(), assets.end(), LARGEST_FIRST(cpuBytes));
+    else if (strcmp(column, "gpu") == 0)
+        stable_sort(assets.begin(), assets.end(), LARGEST_FIRST(gpuBytes));
+    else
+        return false;
+    return true;
+}
+
+void printImportTable(const vector<AssetStats>& assets, const ImportTotals& totals) {
+    printf("%-14s %9s %9s %9s %9s %9s %9s %6s %10s %10s\n", "asset", "parse ms", "post ms",
+           "upload ms", "total ms", "vertices", "faces", "bones", "CPU KB", "GPU KB");
+    for (size_t i = 0; i < assets.size(); i++) {
+        const AssetStats& a = assets[i];
+        char vertices[16], faces[16], bones[16];
+        if (a.isMesh) {
+            snprintf(vertices, sizeof vertices, "%d", a.vertices);
+            snprintf(faces, sizeof faces, "%d", a.faces);
+            snprintf(bones, sizeof bones, "%d", a.bones);
+        } else {
+            snprintf(vertices, sizeof vertices, "%dx%d", a.width, a.height);
+            strcpy(faces, "-");
+            strcpy(bones, "-");
+        }
+        printf("%-14s %9.2f %9.2f %9.2f %9.2f %9s %9s %6s %10.1f %10.1f\n", a.name, a.parseMs, a.postMs,
+               a.uploadMs, totalMs(a), vertices, faces, bones, a.cpuBytes / 1024.0, a.gpuBytes / 1024.0);
+    }
+    printf("\nSerial: %.1f ms to load, %.1f ms to upload.  %d threads: %.1f ms to load (%.2fx)\n",
+           totals.serialLoadMs, totals.serialUploadMs, totals.poolThreads, totals.poolLoadMs,
+           totals.poolLoadMs > 0.0 ? totals.serialLoadMs / totals.poolLoadMs : 0.0);
+}
+
+bool writeImportReport(const char* filename, const vector<AssetStats>& assets,
+                       const ImportTotals& totals) {
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Import bench: can't write %s\n", filename);
+        return false;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"serial_load_ms\": %.3f,\n", totals.serialLoadMs);
+    fprintf(fp, "  \"serial_upload_ms\": %.3f,\n", totals.serialUploadMs);
+    fprintf(fp, "  \"pool_load_ms\": %.3f,\n", totals.poolLoadMs);
+    fprintf(fp, "  \"pool_threads\": %d,\n", totals.poolThreads);
+    fprintf(fp, "  \"assets\": [\n");
+    for (size_t i = 0; i < assets.size(); i++) {
+        const AssetStats& a = assets[i];
+        fprintf(fp, "    { \"name\": \"%s\", \"type\": \"%s\", \"parse_ms\": %.3f, \"post_ms\": %.3f, "
+                    "\"upload_ms\": %.3f, ", a.name, a.isMesh ? "mesh" : "texture", a.parseMs, a.postMs,
+                a.uploadMs);
+        if (a.isMesh)
+            fprintf(fp, "\"vertices\": %d, \"faces\": %d, \"bones\": %d, ", a.vertices, a.faces, a.bones);
+        else
+            fprintf(fp, "\"width\": %d, \"height\": %d, ", a.width, a.height);
+        fprintf(fp, "\"cpu_bytes\": %ld, \"gpu_bytes\": %ld }%s\n", a.cpuBytes, a.gpuBytes,
+                i + 1 < assets.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
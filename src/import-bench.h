@@ -0,0 +1,51 @@
+// ------ Asset import report ---------------------------------------------------
+//
+// --import-bench FILE loads every model and texture in the data directory
+// without opening a window, and reports for each one:
+//
+//   parse     reading the file (aiImportFile without post-processing, or LoadDIBitmap)
+//   post      assimp's post-processing steps (meshes only)
+//   upload    creating the GL buffers or texture, up to glFinish
+//   counts    vertices, faces and bones, or a texture's size
+//   CPU bytes what assimp reports for the scene, or the decoded pixels
+//   GPU bytes the data passed to GL, plus a third for a texture's mipmaps
+//
+// The assets are loaded twice: once serially, which gives the per-asset times,
+// and once on the job threads, which only gives the total time to parse and
+// post-process (GL uploads always happen on the main thread).  The table is
+// printed sorted by --sort (total by default), and everything goes to FILE as
+// JSON.
+
+#ifndef IMPORT_BENCH_H
+#define IMPORT_BENCH_H
+
+#include <vector>
+
+typedef struct {
+    char name[32];          // e.g. "model12.x" or "texture3.bmp"
+    bool isMesh;
+    double parseMs, postMs, uploadMs;
+    int vertices, faces, bones;
+    int width, height;      // Textures only
+    long cpuBytes, gpuBytes;
+} AssetStats;
+
+typedef struct {
+    double serialLoadMs;    // Parse and post-process, one asset after another
+    double serialUploadMs;
+    double poolLoadMs;      // Parse and post-process on the job threads
+    int poolThreads;
+} ImportTotals;
+
+// Sort by a column: name, parse, post, upload, total, vertices, faces, bones,
+// cpu or gpu.  Times and sizes sort largest first.  Returns false for an
+// unknown column.
+bool sortAssetStats(std::vector<AssetStats>& assets, const char* column);
+
+void printImportTable(const std::vector<AssetStats>& assets, const ImportTotals& totals);
+
+// Returns false if the file can't be written.
+bool writeImportReport(const char* filename, const std::vector<AssetStats>& assets,
+                       const ImportTotals& totals);
+
+#endif // IMPORT_BENCH_H
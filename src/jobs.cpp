@@ -0,0 +1,107 @@
+#include "jobs.h"
+#include "trace.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+
+// Workers live until the program exits, so the pool is never destroyed: running
+// the destructors of a condition variable that threads still wait on can hang exit.
+struct JobPool {
+    int numWorkers;
+    std::mutex mutex;          // Guards the fields below
+    std::condition_variable start, done;
+    const std::function<void(int, int)>* body;
+    int count, grain;
+    unsigned generation;       // Bumped for every parallelFor so workers see new work
+    int active;                // Workers still inside the current parallelFor
+    std::atomic<int> nextItem;
+    std::mutex callMutex;      // One parallelFor at a time
+};
+
+static JobPool* pool = NULL;
+static thread_local bool insideJob = false;
+
+// Take ranges until the loop is exhausted.
+static void runRanges(const std::function<void(int, int)>& body, int count, int grain) {
+    for(;;) {
+        int begin = pool->nextItem.fetch_add(grain);
+        if(begin >= count) return;
+        TraceZone zone("job");
+        body(begin, begin + grain < count ? begin + grain : count);
+    }
+}
+
+static void workerLoop(int index) {
+    insideJob = true;
+    char* name = new char[16];  // Lives as long as the thread
+    snprintf(name, 16, "worker %d", index);
+    setTraceThreadName(name);
+
+    unsigned seen = 0;
+    for(;;) {
+        const std::function<void(int, int)>* body;
+        int count, grain;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->start.wait(lock, [&]{ return pool->generation != seen; });
+            seen = pool->generation;
+            body = pool->body;
+            count = pool->count;
+            grain = pool->grain;
+        }
+
+        runRanges(*body, count, grain);
+
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if(--pool->active == 0) pool->done.notify_one();
+    }
+}
+
+void initJobs(int numThreads) {
+    if(pool != NULL) return;
+    if(numThreads <= 0) numThreads = std::thread::hardware_concurrency();
+
+    pool = new JobPool();
+    pool->numWorkers = numThreads > 1 ? numThreads - 1 : 0;
+    pool->generation = 0;
+    for(int i=0; i < pool->numWorkers; i++)
+        std::thread(workerLoop, i+1).detach();
+}
+
+int numJobThreads() {
+    return pool == NULL ? 1 : pool->numWorkers + 1;
+}
+
+void parallelFor(int count, int grain, const std::function<void(int, int)>& body) {
+    if(count <= 0) return;
+    if(grain < 1) grain = 1;
+
+    // Small loops, nested loops and a single core aren't worth waking anyone for.
+    if(numJobThreads() == 1 || insideJob || count <= grain) {
+        body(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> call(pool->callMutex);
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->nextItem = 0;
+        pool->body = &body;
+        pool->count = count;
+        pool->grain = grain;
+        pool->active = pool->numWorkers;
+        pool->generation++;
+    }
+    pool->start.notify_all();
+
+    insideJob = true;
+    runRanges(body, count, grain);
+    insideJob = false;
+
+    // body lives on our stack, so wait until no worker can still be using it.
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->done.wait(lock, []{ return pool->active == 0; });
+}
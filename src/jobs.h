@@ -0,0 +1,23 @@
+// ------ Job system ------------------------------------------------------------
+//
+// A fixed pool of worker threads for splitting loops across cores.  The thread
+// calling parallelFor works on the loop too and returns once every range is
+// done, so callers can treat it like an ordinary (if unordered) for loop.
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <functional>
+
+// Start the workers.  numThreads counts the calling thread; 0 means one per core.
+// parallelFor runs serially until this has been called.
+void initJobs(int numThreads = 0);
+
+// Number of threads that take part in a parallelFor, including the caller.
+int numJobThreads();
+
+// Call body(begin, end) over [0, count) in ranges of about grain items, on all
+// threads.  Calls from inside a job run serially on the current thread.
+void parallelFor(int count, int grain, const std::function<void(int, int)>& body);
+
+#endif // JOBS_H
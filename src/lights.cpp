@@ -0,0 +1,213 @@
+#include "lights.h"
+#include "jobs.h"
+#include "texture-buffers.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+// Light records are uploaded as two RGBA32F texels each, so they must pack to 32 bytes.
+static_assert(sizeof(Light) == 8 * sizeof(GLfloat), "Light must be two vec4s");
+
+// Texture buffers: the lights, each cluster's (offset, count) into the index
+// list, and the index list itself.
+static GLuint lightDataBuffer, clusterGridBuffer, lightIndexBuffer;
+static GLuint lightDataTex, clusterGridTex, lightIndexTex;
+
+static int numDirLights = 0;
+static float clusterNear = 0.1, clusterSliceScale = 1.0;
+static vec3 ambientLight;
+
+// Cluster ranges covered by each point light: x0, x1, y0, y1, z0, z1 (inclusive).
+// x1 < x0 marks a light that reaches no cluster.
+typedef struct { int x0, x1, y0, y1, z0, z1; } ClusterRange;
+
+static std::vector<ClusterRange> ranges;
+static std::vector<GLuint> sliceIndices[clusterSlices];   // Light indices, by slice
+static std::vector<GLuint> sliceGrid[clusterSlices];      // (offset, count) within the slice
+static std::vector<GLuint> grid, indices;
+
+float pointLightRadius(vec3 color) {
+    float brightest = max(color.x, max(color.y, color.z));
+    return brightest > 0.0 ? sqrt(brightest * 256.0) : 0.0;
+}
+
+void initLightClusters() {
+    GLuint buffers[3];
+    glGenBuffers(3, buffers);
+    lightDataBuffer = buffers[0];
+    clusterGridBuffer = buffers[1];
+    lightIndexBuffer = buffers[2];
+
+    // Buffers need a data store before they're first sampled.
+    GLfloat zeros[8] = { 0 };
+    for(int i=0; i<3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof zeros, zeros, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    lightDataTex = createBufferTexture(lightDataBuffer, GL_RGBA32F);
+    clusterGridTex = createBufferTexture(clusterGridBuffer, GL_RG32UI);
+    lightIndexTex = createBufferTexture(lightIndexBuffer, GL_R32UI);
+    CheckError();
+}
+
+static int sliceOf(float depth) {
+    int slice = (int) floor(log(depth / clusterNear) * clusterSliceScale);
+    return slice < 0 ? 0 : (slice >= clusterSlices ? clusterSlices-1 : slice);
+}
+
+static int tileOf(float ndc, int tiles) {
+    int tile = (int) floor((ndc * 0.5 + 0.5) * tiles);
+    return tile < 0 ? 0 : (tile >= tiles ? tiles-1 : tile);
+}
+
+// Find the block of clusters overlapped by the bounding box of a light's sphere.
+static ClusterRange clusterRangeOf(const Light& light, const mat4& projection, float near, float far) {
+    ClusterRange r = { 0, -1, 0, -1, 0, -1 };
+    vec4 c = light.eyePos;
+    float radius = light.radius;
+
+    if(c.z - radius > -near || c.z + radius < -far)
+        return r;  // Entirely in front of the near plane or beyond the far plane
+
+    r.z0 = sliceOf(max(-(c.z + radius), near));
+    r.z1 = sliceOf(min(-(c.z - radius), far));
+
+    if(c.z + radius > -near) {
+        // The sphere reaches the near plane, so its projection can cover the whole screen.
+        r.x0 = r.y0 = 0;
+        r.x1 = clusterTilesX-1;
+        r.y1 = clusterTilesY-1;
+        return r;
+    }
+
+    // Every corner of the box is in front of the camera, so w > 0 for all of them.
+    float x0 = 1e30, x1 = -1e30, y0 = 1e30, y1 = -1e30;
+    for(int corner=0; corner<8; corner++) {
+        vec4 p(c.x + (corner & 1 ? radius : -radius),
+               c.y + (corner & 2 ? radius : -radius),
+               c.z + (corner & 4 ? radius : -radius), 1.0);
+        vec4 clip = projection * p;
+        x0 = min(x0, clip.x / clip.w);  x1 = max(x1, clip.x / clip.w);
+        y0 = min(y0, clip.y / clip.w);  y1 = max(y1, clip.y / clip.w);
+    }
+    if(x1 < -1.0 || x0 > 1.0 || y1 < -1.0 || y0 > 1.0)
+        return r;  // Off screen
+
+    r.x0 = tileOf(x0, clusterTilesX);  r.x1 = tileOf(x1, clusterTilesX);
+    r.y0 = tileOf(y0, clusterTilesY);  r.y1 = tileOf(y1, clusterTilesY);
+    return r;
+}
+
+// Build the (offset, count) grid and the index list for one depth slice.
+// Each slice is written by one thread only, so there's no locking.
+static void binSlice(int z, int firstPoint, int numPoint) {
+    const int tiles = clusterTilesX * clusterTilesY;
+    std::vector<GLuint>& sGrid = sliceGrid[z];
+    std::vector<GLuint>& sIndices = sliceIndices[z];
+    sGrid.assign(tiles * 2, 0);
+
+    // Count, then turn the counts into offsets, then fill.
+    for(int l=0; l < numPoint; l++) {
+        const ClusterRange& r = ranges[l];
+        if(r.x1 < r.x0 || z < r.z0 || z > r.z1) continue;
+        for(int y=r.y0; y <= r.y1; y++)
+            for(int x=r.x0; x <= r.x1; x++)
+                sGrid[(y*clusterTilesX + x)*2 + 1]++;
+    }
+
+    GLuint total = 0;
+    for(int t=0; t < tiles; t++) {
+        sGrid[t*2] = total;
+        total += sGrid[t*2 + 1];
+        sGrid[t*2 + 1] = 0;
+    }
+    sIndices.resize(total);
+
+    for(int l=0; l < numPoint; l++) {
+        const ClusterRange& r = ranges[l];
+        if(r.x1 < r.x0 || z < r.z0 || z > r.z1) continue;
+        for(int y=r.y0; y <= r.y1; y++)
+            for(int x=r.x0; x <= r.x1; x++) {
+                GLuint* cell = &sGrid[(y*clusterTilesX + x)*2];
+                sIndices[cell[0] + cell[1]++] = firstPoint + l;
+            }
+    }
+}
+
+void updateLightClusters(const Light* lights, int numDirectional, int numPoint,
+                         const mat4& projection, float near, float far) {
+    numDirLights = numDirectional;
+    clusterNear = near;
+    clusterSliceScale = clusterSlices / log(far / near);
+
+    // Point lights' ambient light fades with distance, so is added per cluster.
+    ambientLight = vec3(0.0, 0.0, 0.0);
+    for(int i=0; i < numDirectional; i++)
+        ambientLight += lights[i].color;
+
+    const Light* points = lights + numDirectional;
+    ranges.resize(numPoint);
+    parallelFor(numPoint, 64, [&](int begin, int end) {
+        for(int l=begin; l < end; l++)
+            ranges[l] = clusterRangeOf(points[l], projection, near, far);
+    });
+
+    parallelFor(clusterSlices, 1, [&](int begin, int end) {
+        for(int z=begin; z < end; z++)
+            binSlice(z, numDirectional, numPoint);
+    });
+
+    // Join the slices, rebasing each slice's offsets into the combined list.
+    grid.resize(numClusters * 2);
+    indices.clear();
+    for(int z=0; z < clusterSlices; z++) {
+        GLuint base = indices.size();
+        const std::vector<GLuint>& sGrid = sliceGrid[z];
+        GLuint* out = &grid[z * clusterTilesX * clusterTilesY * 2];
+        for(size_t t=0; t < sGrid.size(); t += 2) {
+            out[t] = base + sGrid[t];
+            out[t+1] = sGrid[t+1];
+        }
+        indices.insert(indices.end(), sliceIndices[z].begin(), sliceIndices[z].end());
+    }
+    if(indices.empty()) indices.push_back(0);  // Keep the buffer non-empty
+
+    // Orphan and refill each buffer, so the driver needn't wait for the last frame.
+    int numLights = numDirectional + numPoint;
+    glBindBuffer(GL_TEXTURE_BUFFER, lightDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(Light) * max(numLights, 1), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(Light) * numLights, lights);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, clusterGridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint) * grid.size(), &grid[0], GL_STREAM_DRAW);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, lightIndexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    CheckError();
+}
+
+void bindLightClusters() {
+    glActiveTexture(GL_TEXTURE0 + lightDataUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lightDataTex);
+    glActiveTexture(GL_TEXTURE0 + clusterGridUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, clusterGridTex);
+    glActiveTexture(GL_TEXTURE0 + lightIndexUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lightIndexTex);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void setLightClusterUniforms(const ShaderVariant* shader, int windowWidth, int windowHeight) {
+    glUniform1i(shader->lightDataU, lightDataUnit);
+    glUniform1i(shader->clusterGridU, clusterGridUnit);
+    glUniform1i(shader->lightIndicesU, lightIndexUnit);
+    glUniform1i(shader->numDirLightsU, numDirLights);
+    glUniform3i(shader->clusterDimsU, clusterTilesX, clusterTilesY, clusterSlices);
+    glUniform2f(shader->clusterDepthU, clusterNear, clusterSliceScale);
+    glUniform2f(shader->screenSizeU, windowWidth, windowHeight);
+    glUniform3fv(shader->ambientLightU, 1, ambientLight);
+}
@@ -0,0 +1,55 @@
+// ------ Clustered lighting ----------------------------------------------------
+//
+// Any number of light objects are gathered each frame into a texture buffer.
+// The view frustum is split into a grid of clusters - tiles across the screen
+// and exponentially spaced slices in depth - and each cluster gets a list of
+// the point lights whose range reaches it.  The fragment shader finds its
+// cluster from gl_FragCoord and its depth and loops over that list only, so
+// the cost of a pixel follows the lights near it rather than the total.
+//
+// Directional lights reach everything and are looped over by every fragment.
+
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "Angel.h"
+#include "shader-cache.h"
+
+enum LightType {
+    LIGHT_NONE = 0,      // An ordinary object
+    LIGHT_POINT,         // Attenuated with distance, specular highlights
+    LIGHT_DIRECTIONAL    // Shines from the direction of the object, seen from the origin
+};
+
+typedef struct {
+    vec4 eyePos;   // Eye coordinates: a position for point lights, a direction (w=0) otherwise
+    vec3 color;    // rgb * brightness
+    float radius;  // Distance beyond which a point light is ignored
+} Light;
+
+// Cluster grid dimensions: tiles across, tiles up, depth slices.
+const int clusterTilesX = 16, clusterTilesY = 9, clusterSlices = 24;
+const int numClusters = clusterTilesX * clusterTilesY * clusterSlices;
+
+// Texture units used for the light data, after the object's texture on unit 0.
+const int lightDataUnit = 1, clusterGridUnit = 2, lightIndexUnit = 3;
+
+// The distance at which a point light's 1/d^2 falloff drops below what an 8-bit
+// colour channel can show, which is where its contribution is cut off.
+float pointLightRadius(vec3 color);
+
+// Create the buffers and textures.  Needs a current GL context.
+void initLightClusters();
+
+// Bin the lights (directional first, then point) for this frame and upload
+// them.  near and far must match the projection.
+void updateLightClusters(const Light* lights, int numDirectional, int numPoint,
+                         const mat4& projection, float near, float far);
+
+// Bind the light buffers to their texture units.
+void bindLightClusters();
+
+// Set a shader variant's light and cluster uniforms for this frame.
+void setLightClusterUniforms(const ShaderVariant* shader, int windowWidth, int windowHeight);
+
+#endif // LIGHTS_H
@@ -0,0 +1,82 @@
+#include "pose-cache.h"
+#include "jobs.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+
+using namespace std;
+
+typedef struct {
+    int meshId, animNum;
+    long long tick;  // The pose time in quanta
+} PoseKey;
+
+static bool operator<(const PoseKey& a, const PoseKey& b) {
+    if (a.meshId != b.meshId) return a.meshId < b.meshId;
+    if (a.animNum != b.animNum) return a.animNum < b.animNum;
+    return a.tick < b.tick;
+}
+
+typedef struct {
+    const Skeleton* skeleton;
+    int animNum;
+    float poseTime;  // Already rounded
+    int offset;      // Into palettes, in matrices
+} PendingPose;
+
+static map<PoseKey, int> offsets, lastOffsets;
+static vector<PendingPose> pending;
+static vector<mat4> palettes, lastPalettes;
+
+void beginPoseCacheFrame() {
+    offsets.swap(lastOffsets);
+    palettes.swap(lastPalettes);
+    offsets.clear();
+    pending.clear();
+    palettes.clear();
+}
+
+int requestPose(int meshId, const Skeleton* skeleton, int animNum, float poseTime) {
+    PoseKey key = { meshId, animNum, llround(poseTime / poseTimeQuantum) };
+    map<PoseKey, int>::iterator found = offsets.find(key);
+    if (found != offsets.end())
+        return found->second;
+
+    int offset = palettes.size(), size = max(skeleton->boneNode.size(), (size_t) 1);
+    offsets[key] = offset;
+    found = lastOffsets.find(key);
+    if (found != lastOffsets.end()) {
+        palettes.insert(palettes.end(), lastPalettes.begin() + found->second,
+                        lastPalettes.begin() + found->second + size);
+        return offset;
+    }
+
+    PendingPose pose = { skeleton, animNum, (float) (key.tick * poseTimeQuantum), offset };
+    palettes.resize(offset + size);
+    pending.push_back(pose);
+    return offset;
+}
+
+void calculatePoses() {
+    TraceZone zone("calculatePoses");
+
+    // A pose is a few microseconds of work for a typical skeleton, so a few to a range.
+    parallelFor(pending.size(), 4, [](int begin, int end) {
+        static thread_local PoseScratch scratch;
+        for (int p = begin; p < end; p++) {
+            const PendingPose& pose = pending[p];
+            calculateSkeletonPose(pose.skeleton, pose.animNum, pose.poseTime, &scratch, &palettes[pose.offset]);
+        }
+    });
+    pending.clear();
+}
+
+const mat4* posePalettes() {
+    return palettes.data();
+}
+
+int posePalettesSize() {
+    return palettes.size();
+}
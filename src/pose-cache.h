@@ -0,0 +1,44 @@
+// ------ Pose cache ------------------------------------------------------------
+//
+// Every instance of a mesh drawn at the same point in the same animation needs
+// the same bone palette.  The cache keeps the palettes wanted during a frame,
+// keyed by mesh, clip and pose time rounded to poseTimeQuantum, so only the
+// first instance pays for posing.  Poses are calculated at the rounded time, so
+// instances that share a palette agree exactly.  A pose that was also wanted
+// last frame (an object held at its last pose, as the animation LOD tiers do)
+// is copied from last frame's buffer rather than calculated again.
+//
+// Posing is a stage of its own, before any drawing: the visible objects ask for
+// their poses with requestPose, then calculatePoses evaluates all the distinct
+// ones at once, spread over the job threads.  The palettes are packed one after
+// another into a single buffer, so the whole frame's worth can be uploaded in
+// one go (see bone-palettes.h), and each object finds its palette by its
+// offset into the buffer.
+//
+// requestPose and calculatePoses are for the drawing thread only.
+
+#ifndef POSE_CACHE_H
+#define POSE_CACHE_H
+
+#include "skeleton.h"
+
+const float poseTimeQuantum = 1.0f / 128.0f;  // In animation ticks
+
+// Start a new frame's buffer, keeping the last frame's to copy from.
+void beginPoseCacheFrame();
+
+// Reserve space for meshId's palette, posed from its skeleton, with one matrix
+// per bone (or one identity matrix, as calculateSkeletonPose gives).  Returns
+// its offset into the buffer, in matrices.  Nothing is calculated until
+// calculatePoses.
+int requestPose(int meshId, const Skeleton* skeleton, int animNum, float poseTime);
+
+// Calculate every palette requested since beginPoseCacheFrame, in parallel.
+void calculatePoses();
+
+// The buffer of palettes, and its size in matrices.  Valid after calculatePoses
+// until the next requestPose.
+const mat4* posePalettes();
+int posePalettesSize();
+
+#endif // POSE_CACHE_H
@@ -36,6 +36,7 @@
 #include "Angel.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <dirent.h>
 #include <time.h>
 
@@ -45,6 +46,34 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+// Shader variants are built from vStart.glsl/fStart.glsl by feature bits and cached on disk.
+#include "gl-extra.h"
+#include "shader-cache.h"
+
+// Any number of lights, binned into view-frustum clusters on the worker threads.
+#include "jobs.h"
+#include "lights.h"
+
+// Sleeps until each frame is due (or lets the swap interval do it) instead of spinning.
+#include "frame-pacer.h"
+#include "simulation.h"
+#include "headless.h"
+#include "frame-stats.h"
+#include "bench.h"
+#include "frame-graph.h"
+#include "debug-output.h"
+#include "trace.h"
+#include "import-bench.h"
+#include "skeleton.h"
+#include "pose-cache.h"
+#include "anim-bake.h"
+#include "clip-compress.h"
+#include "anim-lod.h"
+#include "bounds.h"
+#include "skin-prepass.h"
+#include "bone-palettes.h"
+#include "scene-store.h"
+
 // Previous values are saved when fullscreen mode is toggled to facilitate graceful restore.
 GLint windowHeight=640, windowWidth=960, prevWindowHeight=640, prevWindowWidth=960;
 
@@ -56,22 +85,27 @@ GLint windowHeight=640, windowWidth=960, prevWindowHeight=640, prevWindowWidth=9
 using namespace std;    // Import the C++ standard functions (e.g., min) 
 
 
-// IDs for the GLSL program and GLSL variables.
-GLuint shaderProgram; // The number identifying the GLSL shader program
-GLuint vPosition, vNormal, vTexCoord, vBoneIDs, vBoneWeights; // IDs for vshader input vars (from glGetAttribLocation)
-GLuint projectionU, viewU, modelViewU, boneTransformsU; // IDs for uniform variables (from glGetUniformLocation)
+// IDs for the vshader input vars.  These are bound to the same locations in every
+// shader variant (see shader-cache.h) so a mesh's VAO works with all of them.
+const GLuint vPosition = ATTRIB_POSITION, vNormal = ATTRIB_NORMAL, vTexCoord = ATTRIB_TEXCOORD,
+             vBoneIDs = ATTRIB_BONE_IDS, vBoneWeights = ATTRIB_BONE_WEIGHTS;
+
+// The variant with every feature enabled, which stands in for the others while they compile.
+const unsigned uberShader = SHADER_SKINNED | SHADER_TEXTURED | SHADER_ALPHA;
 
 static float viewDist = 20; // Distance from the camera to the centre of the scene
 static float camRotSidewaysDeg=0; // rotates the camera sideways around the centre
 static float camRotUpAndOverDeg=10; // rotates the camera up and over the centre.
 
 mat4 projection; // Projection matrix - set in the reshape function
+float nearDist, farDist; // The projection's clipping planes, needed to bin lights
 mat4 view; // View matrix - set in the display function.
 
 // These are used to set the window title
 char lab[] = "Project 1";
 char *programName = NULL; // Set in main 
 int numDisplayCalls = 0; // Used to calculate the number of frames per second
+int frameCount = 0; // Total frames drawn, used to set per-frame uniforms once per shader
 
 // -----Meshes----------------------------------------------------------
 // Uses the type aiMesh from ../../assimp--3.0.1270/include/assimp/mesh.h
@@ -80,6 +114,9 @@ int numDisplayCalls = 0; // Used to calculate the number of frames per second
 aiMesh* meshes[numMeshes]; // For each mesh we have a pointer to the mesh to draw
 GLuint vaoIDs[numMeshes]; // and a corresponding VAO ID from glGenVertexArrays
 const aiScene* scenes[numMeshes];
+Skeleton* skeletons[numMeshes]; // Compiled from the scene, for posing (see skeleton.h)
+BakedClip* bakedClips[numMeshes]; // Each skinned mesh's first clip, baked when first needed (see anim-bake.h)
+PrepassMesh prepassMeshes[numMeshes]; // Where each mesh's vertex data is, for the skinning pre-pass
 
 // -----Textures---------------------------------------------------------
 //                      (numTextures is defined in gnatidread.h)
@@ -89,30 +126,14 @@ GLuint textureIDs[numTextures]; // Stores the IDs returned by glGenTextures
 
 // ------Scene Objects--------------------------------------------------------------------------------------
 //
-// For each object in a scene we store the following
-// Note: the following is exactly what the sample solution uses, you can do things differently if you want.
-typedef struct {
-    vec4 loc;
-    float scale;
-    float angles[3]; // rotations around X, Y and Z axes.
-    float diffuse, specular, ambient; // Amount of each light component
-    float shine;
-    vec3 rgb;
-    float alpha;
-    float brightness; // Multiplies all colours
-    int meshId;
-    int texId;
-    float texScale;
-} SceneObject;
-
-const int maxObjects = 1024; // Scenes with more than 1024 objects seem unlikely
-
-SceneObject sceneObjs[maxObjects]; // An array storing the objects currently in the scene.
-bool hidden[maxObjects];
-
-int nObjects=0; // How many objects are currenly in the scene.
-int currObject=-1; // The current object
-int toolObj = -1;  // The object currently being modified
+// The objects in the scene, one array per field, indexed from 0 to objects.count-1 (see
+// scene-store.h).  Indices change when an object is deleted, so objects are kept track
+// of between frames by their handles.
+SceneStore objects;
+
+ObjectHandle ground, firstLight, secondLight; // Added by init - the Lights menu adjusts the two lights
+ObjectHandle currObject = noObject; // The current object
+ObjectHandle toolObj = noObject;  // The object currently being modified
 
 int selectMenuId;
 
@@ -120,6 +141,10 @@ float animFrame = 0.0;
 float animDistance = 5.0;
 float animSpeed = 10.0;
 bool animSin = false;
+bool bakedAnimation = false; // Draw skinned objects instanced, posed from baked clips ('b')
+bool compressAnimation = false; // Pose from compressed clips (see clip-compress.h)
+bool animLod = true; // Pose and skin small skinned objects less ('l', see anim-lod.h)
+bool prepassSkinning = false; // Skin each pose once, before drawing ('k', see skin-prepass.h)
 
 float fov = 20.0;
 
@@ -149,8 +174,40 @@ float fov = 20.0;
 //                     (binoculars / gun scope)
 //                 v* - toggle vsync
 //                 f* - toggle fullscreen
+//                 t* - toggle the frame-time graph
+//                 c* - save recent frame times to
+//                      frame-stats.csv
+//                 r* - start tracing; press again to
+//                      stop and save trace.json
+//                 b* - toggle baked, instanced animation
+//                      of skinned models (anim-bake.h)
+//                 l* - toggle animation LOD for small
+//                      skinned models (anim-lod.h)
+//                 k* - toggle the skinning pre-pass
+//                      (skin-prepass.h)
 //
 // * also works in design mode
+//
+// The frame rate can be capped with --fps N on the
+// command line (0 for no cap), and --sim-thread runs
+// the movement and animation steps on their own thread.
+// --headless WxH [--frames N] [--save-frames PREFIX]
+// renders N frames offscreen, without a display, and
+// --bench SCENE [--bench-out FILE] measures a scripted
+// run over a bench scene (see bench.h) as JSON.
+// In debug builds --gl-debug high|medium|low|all sets
+// which GL debug messages are shown (medium by default).
+// --trace records a trace from startup, as if r had
+// been pressed before init (saved on the next r, or at
+// the end of a headless run).
+// --import-bench FILE [--sort COLUMN] loads every model
+// and texture, serially and on all threads, and
+// reports the cost of each (see import-bench.h).
+// --baked-anim starts with baked animation on, as if b
+// had been pressed.  --compress-anim poses skinned
+// models from compressed clips (see clip-compress.h).
+// --skin-prepass starts with the skinning pre-pass on,
+// as if k had been pressed.
 // 
 // The arrow keys also perform head movement
 // for machines with no point and click input.
@@ -162,27 +219,13 @@ float fov = 20.0;
 bool gameMode = false;
 bool vsync = true;
 bool fullscreen = false;
-int Hz = 60; // monitor refresh rate for vsync
+bool showFrameGraph = false;
+DebugLevel glDebugLevel = DEBUG_LEVEL_MEDIUM; // Set with --gl-debug (debug builds only)
 
-// Scaling constants.
-// The delta will also be scaled according to time as opposed
-// to processing speed to prevent time compression occuring
-// on modern systems.
-const float turnScale = 0.1;
+// Mouse look scale.  Movement, jumping and the keyboard turn rate
+// are stepped at a fixed rate in simulation.cpp, so they don't
+// depend on the frame rate.
 const float mouseTurnScale = 0.2;
-const float moveScale = 0.003;
-const float gravity = 0.00004;
-const float impulse = 0.01;
-// Position and rotation variables.
-// Each represents the current variation from 0,0,0,0,0,0.
-// Used to construct the view matrix in game mode.
-static float yaw = 0.0;
-static float pitch = 0.0;
-static float dx = 0.0;
-static float dy = 1.5;
-static float dz = 0.0;
-// Intertia, impulse, and gravity are used in character jumping.
-static float inertia = impulse;
 // These variables act as toggles to detect key depression.
 // The approach is more graceful than allowing key repetition
 // (which varies from system to system and device to device)
@@ -196,9 +239,40 @@ bool strafeLeft = false;
 bool strafeRight = false;
 bool yawLeft = false;
 bool yawRight = false;
-bool jump = false;
-int t = 0; // set in display: = glutGet(GLUT_ELAPSED_TIME);
-int dt = 0;
+
+// Hand the held keys to the simulation.
+static void updateSimInput() {
+    SimInput input = { gameMode, runForward, runBack, strafeLeft, strafeRight,
+                       yawLeft, yawRight, pitchUp, pitchDown };
+    setSimInput(input);
+}
+
+// ------------------------------------------------------------------------------------------
+// Frames are only drawn when something has changed.  Anything that changes the scene, the
+// camera or the window calls requestRedraw(), which registers the idle callback.  display()
+// keeps it registered while things change by themselves (held movement keys, a jump,
+// skinned animation) and removes it otherwise, so an untouched window uses almost no CPU.
+// ------------------------------------------------------------------------------------------
+
+void idle(void);
+
+static bool idleRegistered = false;
+
+// With --headless there's no window or GLUT: main() calls display() directly, for
+// frames a simulation step apart so the output doesn't depend on timing.
+static bool headless = false;
+static int headlessFrame = 0;
+
+static double frameTime() {
+    return headless ? (headlessFrame + 0.5) * simStep : monotonicSeconds();
+}
+
+static void requestRedraw() {
+    if (!idleRegistered && !headless) {
+        glutIdleFunc(idle);
+        idleRegistered = true;
+    }
+}
 
 // ------------------------------------------------------------------------------------------
 // Reshape is used in many aspects of the game mode operation. A function signature could be
@@ -232,11 +306,16 @@ void reshape(int width, int height) {
     //   - when the width is less than the height, the view should adjust so that the same part
     //     of the scene is visible across the width of the window.
 
+    nearDist = 0.1;
     if (gameMode) {
-        projection = Perspective(gameFOV, (float)width/(float)height, 0.1, 50.0);
+        farDist = 50.0;
+        projection = Perspective(gameFOV, (float)width/(float)height, nearDist, farDist);
     } else {
-        projection = Perspective(fov, (float)width/(float)height, 0.1, 100.0);
+        farDist = 100.0;
+        projection = Perspective(fov, (float)width/(float)height, nearDist, farDist);
     }
+
+    requestRedraw();
 }
 
 // --------------------------------------
@@ -251,6 +330,7 @@ static void switchMode() {
         glutSetCursor(GLUT_CURSOR_INHERIT);
         gameMode = false;
     }
+    updateSimInput();
     reshape(windowWidth, windowHeight);
 }
 
@@ -271,23 +351,47 @@ static void toggleFullScreen() {
     }
 }
 
+// Start recording a trace, or stop and save it to trace.json.
+static void toggleTracing() {
+    if (!traceEnabled) {
+        setTracing(true);
+        printf("Tracing - press r again to save trace.json\n");
+    } else {
+        setTracing(false);
+        if (writeTrace("trace.json"))
+            printf("Saved trace.json (open it in chrome://tracing or ui.perfetto.dev)\n");
+        else
+            printf("Couldn't write trace.json\n");
+    }
+}
+
 // ------------------------------------------------------------
 // Loads a texture by number, and binds it for later use.  
 // ------------------------------------------------------------
 
+void uploadTexture(int i);
+
 void loadTextureIfNotAlreadyLoaded(int i) {
     if(textures[i] != NULL) return; // The texture is already loaded.
 
     textures[i] = loadTextureNum(i); CheckError();
+    uploadTexture(i);
+}
+
+// Create texture i's mipmapped GL texture from textures[i].
+void uploadTexture(int i) {
     glActiveTexture(GL_TEXTURE0); CheckError();
 
     // Based on: http://www.opengl.org/wiki/Common_Mistakes
     glBindTexture(GL_TEXTURE_2D, textureIDs[i]);
     CheckError();
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, textures[i]->width, textures[i]->height,
-                 0, GL_RGB, GL_UNSIGNED_BYTE, textures[i]->rgbData); CheckError();
-    glGenerateMipmap(GL_TEXTURE_2D); CheckError();
+    {
+        TraceZone zone("glTexImage2D");
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, textures[i]->width, textures[i]->height,
+                     0, GL_RGB, GL_UNSIGNED_BYTE, textures[i]->rgbData); CheckError();
+        glGenerateMipmap(GL_TEXTURE_2D); CheckError();
+    }
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); CheckError();
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); CheckError();
@@ -305,6 +409,8 @@ void loadTextureIfNotAlreadyLoaded(int i) {
 // normals, and texture coordinates.
 // You shouldn't need to modify this - it's called from drawMesh below.
 
+void uploadMesh(int meshNumber);
+
 void loadMeshIfNotAlreadyLoaded(int meshNumber) {
 
     if(meshNumber>=numMeshes || meshNumber < 0) {
@@ -316,11 +422,22 @@ void loadMeshIfNotAlreadyLoaded(int meshNumber) {
     if(meshes[meshNumber] != NULL)
         return; // Already loaded
 
+    TraceZone zone("loadMesh");
+
     const aiScene* scene = loadScene(meshNumber);
     scenes[meshNumber] = scene;
-    aiMesh* mesh = scene->mMeshes[0];
-    meshes[meshNumber] = mesh;
+    meshes[meshNumber] = scene->mMeshes[0];
+    skeletons[meshNumber] = compileSkeleton(scene, meshes[meshNumber]);
+    if (compressAnimation) {
+        compressSkeleton(skeletons[meshNumber], defaultClipTolerance);
+        findClipBounds(skeletons[meshNumber], meshes[meshNumber]);
+    }
+    uploadMesh(meshNumber);
+}
 
+// Fill mesh meshNumber's VAO with the vertex, index and bone data of meshes[meshNumber].
+void uploadMesh(int meshNumber) {
+    aiMesh* mesh = meshes[meshNumber];
     glBindVertexArray( vaoIDs[meshNumber] );
 
     // Create and initialize a buffer object for positions and texture coordinates, initially empty.
@@ -339,17 +456,17 @@ void loadMeshIfNotAlreadyLoaded(int meshNumber) {
 
     // Load the element index data
     GLuint elements[mesh->mNumFaces*3];
-    for(GLuint i=0; i < mesh->mNumFaces; i++) {
-        elements[i*3] = mesh->mFaces[i].mIndices[0];
-        elements[i*3+1] = mesh->mFaces[i].mIndices[1];
-        elements[i*3+2] = mesh->mFaces[i].mIndices[2];
-    }
+    getFaceIndices(mesh, elements);
 
     GLuint elementBufferId[1];
     glGenBuffers(1, elementBufferId);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferId[0]);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * mesh->mNumFaces * 3, elements, GL_STATIC_DRAW);
 
+    PrepassMesh prepass = { vaoIDs[meshNumber], buffer[0], (GLintptr) (sizeof(float)*3*nVerts),
+                            elementBufferId[0], nVerts };
+    prepassMeshes[meshNumber] = prepass;
+
     // vPosition it actually 4D - the conversion sets the fourth dimension (i.e. w) to 1.0         
     glVertexAttribPointer( vPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
     glEnableVertexAttribArray( vPosition );
@@ -385,6 +502,7 @@ void loadMeshIfNotAlreadyLoaded(int meshNumber) {
 
 // --------------------------------------
 static void mouseClickOrScroll(int button, int state, int x, int y) {
+    StageTimer timer(STAGE_INPUT);
     if(button==GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
          if(glutGetModifiers()!=GLUT_ACTIVE_SHIFT) activateTool(button);
          else activateTool(GLUT_MIDDLE_BUTTON);
@@ -409,16 +527,19 @@ static void mouseClickOrScroll(int button, int state, int x, int y) {
             viewDist = (viewDist < 0.0 ? viewDist : viewDist*1.25) + 0.05;
         }
     }
+    requestRedraw();
 }
 
 static void mousePassiveMotion(int x, int y) {
+    StageTimer timer(STAGE_INPUT);
     if (gameMode) {
         if(mouseX < 50 || mouseX > windowWidth - 50 || mouseY < 50 || mouseY > windowHeight - 50) {
             glutWarpPointer(windowWidth/2, windowHeight/2);
         } else {
-            yaw += (gameFOV/300.0f)*(x - mouseX) * mouseTurnScale;
-            pitch += (gameFOV/300.0f)*(y - mouseY) * mouseTurnScale;
+            addSimLook((gameFOV/300.0f)*(x - mouseX) * mouseTurnScale,
+                       (gameFOV/300.0f)*(y - mouseY) * mouseTurnScale);
         }
+        requestRedraw();
     }
     mouseX=x;
     mouseY=y;
@@ -445,17 +566,19 @@ static void adjustcamSideUp(vec2 su) {
 }
   
 static void adjustLocXZ(vec2 xz) { 
-    if (!gameMode)  {
-        sceneObjs[toolObj].loc[0]+=xz[0];
-        sceneObjs[toolObj].loc[2]+=xz[1];
+    int i = objectIndex(objects, toolObj);
+    if (!gameMode && i >= 0)  {
+        objects.loc[i][0]+=xz[0];
+        objects.loc[i][2]+=xz[1];
     }
 }
 
 static void adjustScaleY(vec2 sy) 
 { 
-    if (!gameMode)  {
-        sceneObjs[toolObj].scale+=sy[0];
-        sceneObjs[toolObj].loc[1]+=sy[1];
+    int i = objectIndex(objects, toolObj);
+    if (!gameMode && i >= 0)  {
+        objects.scale[i]+=sy[0];
+        objects.loc[i][1]+=sy[1];
     }
 }
 
@@ -465,44 +588,44 @@ static void doRotate() {
                      adjustcamSideUp, mat2(400, 0, 0,-90) );
 }
 				   
-//------Add an object to the scene
+//------Add an object to the scene, returning its index (until an object is deleted)
 
-static void addObject(int id) {
+static int addObject(int id) {
 
   vec2 currPos = currMouseXYworld(camRotSidewaysDeg);
-  sceneObjs[nObjects].loc[0] = currPos[0];
-  sceneObjs[nObjects].loc[1] = 0.0;
-  sceneObjs[nObjects].loc[2] = currPos[1];
-  sceneObjs[nObjects].loc[3] = 1.0;
+  toolObj = currObject = addSceneObject(&objects);
+  int i = objectIndex(objects, currObject);
+  objects.loc[i] = vec4(currPos[0], 0.0, currPos[1], 1.0);
 
   if(id!=0 && id!=55)
-      sceneObjs[nObjects].scale = 0.005;
+      objects.scale[i] = 0.005;
 
-  sceneObjs[nObjects].rgb[0] = 0.7; sceneObjs[nObjects].rgb[1] = 0.7;
-  sceneObjs[nObjects].rgb[2] = 0.7; sceneObjs[nObjects].brightness = 1.0;
-  sceneObjs[nObjects].alpha = 1.0;
+  objects.rgb[i] = vec3(0.7, 0.7, 0.7); objects.brightness[i] = 1.0;
+  objects.alpha[i] = 1.0;
 
-  sceneObjs[nObjects].diffuse = 1.0; sceneObjs[nObjects].specular = 0.5;
-  sceneObjs[nObjects].ambient = 0.7; sceneObjs[nObjects].shine = 10.0;
+  objects.diffuse[i] = 1.0; objects.specular[i] = 0.5;
+  objects.ambient[i] = 0.7; objects.shine[i] = 10.0;
 
-  sceneObjs[nObjects].angles[0] = 0.0; sceneObjs[nObjects].angles[1] = 180.0;
-  sceneObjs[nObjects].angles[2] = 0.0;
+  objects.angles[i] = vec3(0.0, 180.0, 0.0);
 
-  sceneObjs[nObjects].meshId = id;
-  sceneObjs[nObjects].texId = rand() % numTextures;
-  sceneObjs[nObjects].texScale = 2.0;
+  objects.meshId[i] = id;
+  objects.texId[i] = rand() % numTextures;
+  objects.texScale[i] = 2.0;
+  objects.light[i] = LIGHT_NONE;
+  objects.animOffset[i] = 0.0;
 
-  toolObj = currObject = nObjects++;
   setToolCallbacks(adjustLocXZ, camRotZ(),
                    adjustScaleY, mat2(0.05, 0, 0, 10.0) );
-  glutPostRedisplay();
+  requestRedraw();
+  return i;
 }
 
 // ------ The init function
 
 void init( void )
 {
-    srand ( time(NULL) ); /* initialize random seed - so the starting scene varies */
+    TraceZone zone("init");
+    srand ( headless ? 0 : time(NULL) ); /* initialize random seed - so the starting scene varies */
     aiInit();
 
 //    for(int i=0; i<numMeshes; i++)
@@ -511,45 +634,54 @@ void init( void )
     glGenVertexArrays(numMeshes, vaoIDs); CheckError(); // Allocate vertex array objects for meshes
     glGenTextures(numTextures, textureIDs); CheckError(); // Allocate texture objects
 
-    // Load shaders and use the resulting shader program
-    shaderProgram = InitShader( "src/vStart.glsl", "src/fStart.glsl" );
-
-    glUseProgram( shaderProgram ); CheckError();
-
-    // Initialize the vertex position attribute from the vertex shader    
-    vPosition = glGetAttribLocation( shaderProgram, "vPosition" );
-    vNormal = glGetAttribLocation( shaderProgram, "vNormal" ); CheckError();
-
-    // Likewise, initialize the vertex texture coordinates attribute.  
-    vTexCoord = glGetAttribLocation( shaderProgram, "vTexCoord" ); CheckError();
-
-    // Likewise, initialize the vertex bone attributes.  
-    vBoneIDs = glGetAttribLocation( shaderProgram, "vBoneIDs" );
-    vBoneWeights = glGetAttribLocation( shaderProgram, "vBoneWeights" ); CheckError();
-
-    projectionU = glGetUniformLocation(shaderProgram, "Projection");
-    viewU = glGetUniformLocation(shaderProgram, "View");
-    modelViewU = glGetUniformLocation(shaderProgram, "ModelView");
-    boneTransformsU = glGetUniformLocation(shaderProgram, "BoneTransforms");
-
-    // Objects 0, and 1 are the ground and the first light.
-    addObject(0); // Square for the ground
-    sceneObjs[0].loc = vec4(0.0, 0.0, 0.0, 1.0);
-    sceneObjs[0].scale = 10.0;
-    sceneObjs[0].angles[0] = 90.0; // Rotate it.
-    sceneObjs[0].texScale = 5.0; // Repeat the texture.
-
-    addObject(55); // Sphere for the first light
-    sceneObjs[1].loc = vec4(2.0, 1.0, 1.0, 1.0);
-    sceneObjs[1].scale = 0.1;
-    sceneObjs[1].texId = 0; // Plain texture
-    sceneObjs[1].brightness = 0.8; // The light's brightness is 5 times this (below).
+    // Load the shader sources.  Variants are linked from binaries saved by earlier runs
+    // when possible, and otherwise compiled - in the background if the driver allows.
+    loadGLExtra();
+    initDebugOutput(glDebugLevel); // Debug builds: report GL errors as they happen
+    initShaderCache( "src/vStart.glsl", "src/fStart.glsl", "shader-cache" );
+
+    // Only the all-features variant is waited for; it's used until the others are ready.
+    finishShaderVariant(uberShader); CheckError();
+    requestShaderVariant(SHADER_TEXTURED);
+    requestShaderVariant(SHADER_TEXTURED | SHADER_SKINNED);
+    requestShaderVariant(SHADER_TEXTURED | SHADER_ALPHA); CheckError();
+
+    initJobs(); // Worker threads, used to bin lights and calculate poses
+    initFrameStats(); // GPU timer queries
+    initFrameGraph();
+    initLightClusters(); CheckError();
+    initBakedInstances();
+    initBonePalettes();
+    initSkinPrepass(); CheckError();
+    if (bakedAnimation) {
+        requestShaderVariant(SHADER_TEXTURED | SHADER_SKINNED | SHADER_BAKED);
+        requestShaderVariant(SHADER_TEXTURED | SHADER_SKINNED | SHADER_BAKED | SHADER_ALPHA);
+    }
 
-    addObject(55); // Sphere for the first light
-    sceneObjs[2].loc = vec4(1.0, 2.0, 1.0, 1.0);
-    sceneObjs[2].scale = 0.3;
-    sceneObjs[2].texId = 0; // Plain texture
-    sceneObjs[2].brightness = 0.8; // The light's brightness is 5 times this (below).
+    // The ground and the two starting lights come first.  Any object can be a light,
+    // but these two are the ones the Lights menu adjusts.
+    int i = addObject(0); // Square for the ground
+    ground = currObject;
+    objects.loc[i] = vec4(0.0, 0.0, 0.0, 1.0);
+    objects.scale[i] = 10.0;
+    objects.angles[i][0] = 90.0; // Rotate it.
+    objects.texScale[i] = 5.0; // Repeat the texture.
+
+    i = addObject(55); // Sphere for the first light
+    firstLight = currObject;
+    objects.loc[i] = vec4(2.0, 1.0, 1.0, 1.0);
+    objects.scale[i] = 0.1;
+    objects.texId[i] = 0; // Plain texture
+    objects.brightness[i] = 0.8; // The light's brightness is 5 times this (below).
+    objects.light[i] = LIGHT_POINT;
+
+    i = addObject(55); // Sphere for the second light
+    secondLight = currObject;
+    objects.loc[i] = vec4(1.0, 2.0, 1.0, 1.0);
+    objects.scale[i] = 0.3;
+    objects.texId[i] = 0; // Plain texture
+    objects.brightness[i] = 0.8; // The light's brightness is 5 times this (below).
+    objects.light[i] = LIGHT_DIRECTIONAL;
 
     addObject(rand() % numMeshes); // A test mesh
 
@@ -567,35 +699,39 @@ void init( void )
 
 //----------------------------------------------------------------------------
 
-void drawMesh(SceneObject sceneObj, float pose_time) {
-
-    // Activate a texture, loading if needed.
-    loadTextureIfNotAlreadyLoaded(sceneObj.texId);
-    glActiveTexture(GL_TEXTURE0 );
-    glBindTexture(GL_TEXTURE_2D, textureIDs[sceneObj.texId]);
-
-    // Texture 0 is the only texture type in this program, and is for the rgb colour of the
-    // surface but there could be separate types for, e.g., specularity and normals. 
-    glUniform1i( glGetUniformLocation(shaderProgram, "texture"), 0 );
-
-    // Set the texture scale for the shaders
-    glUniform1f( glGetUniformLocation( shaderProgram, "texScale"), sceneObj.texScale );
-
-    // Set the projection matrix for the shaders
-    glUniformMatrix4fv( projectionU, 1, GL_TRUE, projection );
+// The shader features object i needs.  Its mesh must already be loaded, and
+// if it's skinned, its animation tier chosen.
+static unsigned shaderFeaturesFor(int i) {
+    unsigned features = SHADER_TEXTURED;
+    if (meshes[objects.meshId[i]]->mNumBones > 0)
+        features |= SHADER_SKINNED | animLodShaderFeatures(objects.lod[i]);
+    if (objects.alpha[i] < 1.0)
+        features |= SHADER_ALPHA;
+    return features;
+}
 
-    // Activate the VAO for a mesh, loading if needed.
-    loadMeshIfNotAlreadyLoaded(sceneObj.meshId); CheckError();
-    glBindVertexArray( vaoIDs[sceneObj.meshId] ); CheckError();
-    int nBones = meshes[sceneObj.meshId]->mNumBones;
+// The box a mesh is drawn within: for a skinned mesh, its first clip's (the one
+// that's played), which holds it in every pose.  The mesh must be loaded.
+static const Bounds& drawnBounds(int meshId) {
+    const Skeleton* skeleton = skeletons[meshId];
+    if (meshes[meshId]->mNumBones > 0 && !skeleton->clips.empty())
+        return skeleton->clips[0].bounds;
+    return skeleton->restBounds;
+}
 
-    // Set the model matrix - this should combine translation, rotation and scaling based on what's
-    // in the sceneObj structure (see near the top of the program).
+// The time to pose object i at (which its clip clamps to its length).
+static float poseTimeFor(int i, float pose_time) {
+    return fmod(pose_time + objects.animOffset[i], 50.0);
+}
 
-    vec4 loc = sceneObj.loc;
+// The model matrix - this combines translation, rotation and scaling based on what's in
+// objects (see near the top of the program) for object i.  The mesh must be loaded.
+static mat4 modelMatrix(int i, float pose_time) {
+    vec4 loc = objects.loc[i];
+    const vec3& angles = objects.angles[i];
 
     // If model has bones, translate according to pose_time
-    if (nBones > 0) {
+    if (meshes[objects.meshId[i]]->mNumBones > 0) {
         float animProg = fmod(pose_time * animSpeed, 2000.0) / 2000.0;
 
         if (animProg > 0.5) {
@@ -604,48 +740,180 @@ void drawMesh(SceneObject sceneObj, float pose_time) {
 
         float animTranslate = (animProg * 2.0 - 0.5) * animDistance;
 
-        loc.x += animTranslate * sin(sceneObj.angles[1] * DegreesToRadians);
-        loc.z += animTranslate * cos(sceneObj.angles[1] * DegreesToRadians);
+        loc.x += animTranslate * sin(angles[1] * DegreesToRadians);
+        loc.z += animTranslate * cos(angles[1] * DegreesToRadians);
 
         if (animSin) {
             float strafe = sin(animProg * 360.0 * 5.0 * DegreesToRadians) * animDistance / 20.0;
 
-            loc.x += strafe * cos(sceneObj.angles[1] * DegreesToRadians);
-            loc.z += strafe * sin(sceneObj.angles[1] * DegreesToRadians);
+            loc.x += strafe * cos(angles[1] * DegreesToRadians);
+            loc.z += strafe * sin(angles[1] * DegreesToRadians);
         }
     }
 
     mat4 model = Translate(loc);
-    model = model * RotateY(sceneObj.angles[1]);
-    model = model * RotateZ(sceneObj.angles[2]);
-    model = model * RotateX(sceneObj.angles[0]);
-    model = model * Scale(sceneObj.scale);
+    model = model * RotateY(angles[1]);
+    model = model * RotateZ(angles[2]);
+    model = model * RotateX(angles[0]);
+    model = model * Scale(objects.scale[i]);
+    return model;
+}
+
+// Bind object i's texture and VAO, loading them if needed.
+static void bindTextureAndMesh(int i, const ShaderVariant* shader) {
+    // Activate a texture, loading if needed.
+    int texId = objects.texId[i];
+    loadTextureIfNotAlreadyLoaded(texId);
+    glActiveTexture(GL_TEXTURE0 );
+    glBindTexture(GL_TEXTURE_2D, textureIDs[texId]);
+
+    // Set the texture scale for the shaders
+    glUniform1f( shader->texScaleU, objects.texScale[i] );
+
+    // Activate the VAO for a mesh, loading if needed.
+    int meshId = objects.meshId[i];
+    loadMeshIfNotAlreadyLoaded(meshId); CheckError();
+    glBindVertexArray( vaoIDs[meshId] ); CheckError();
+}
+
+// paletteBase is the object's palette in the frame's palette buffer (see bone-palettes.h).
+// skinnedVao, unless 0, draws the object's vertices as the skinning pre-pass left them,
+// which needs an unskinned shader variant.
+void drawMesh(int i, float pose_time, int paletteBase, GLuint skinnedVao, const ShaderVariant* shader) {
+    TraceZone zone("drawMesh");
+    StageTimer uniformTimer(STAGE_UNIFORMS);
+
+    bindTextureAndMesh(i, shader);
+    if (skinnedVao != 0) {
+        glBindVertexArray(skinnedVao); CheckError();
+    }
 
     // Set the model-view matrix for the shaders
-    glUniformMatrix4fv( viewU, 1, GL_TRUE, view );
-    glUniformMatrix4fv( modelViewU, 1, GL_TRUE, view * model );
+    glUniformMatrix4fv( shader->modelViewU, 1, GL_TRUE, view * modelMatrix(i, pose_time) );
 
-    mat4 boneTransforms[64];
-    calculateAnimPose(meshes[sceneObj.meshId], scenes[sceneObj.meshId], 0, fmod(pose_time, 50.0), boneTransforms);
-    glUniformMatrix4fv(boneTransformsU, max(nBones, 1), GL_TRUE, (const GLfloat *)boneTransforms);
+    // The skinned variant may stand in for an unskinned one while it compiles, in
+    // which case paletteBase is the identity palette.
+    if (shader->features & SHADER_SKINNED) {
+        glUniform1i(shader->paletteBaseU, paletteBase);
+    }
 
-    glDrawElements(GL_TRIANGLES, meshes[sceneObj.meshId]->mNumFaces * 3, GL_UNSIGNED_INT, NULL); CheckError();
+    StageTimer drawTimer(STAGE_DRAW);
+    int numFaces = meshes[objects.meshId[i]]->mNumFaces;
+    glDrawElements(GL_TRIANGLES, numFaces * 3, GL_UNSIGNED_INT, NULL); CheckError();
+    frameStats.drawCalls++;
+    frameStats.triangles += numFaces;
 }
 
 
-void display(void) {
+// Set the uniforms for object i's material, and on the first use of the shader
+// variant in a frame, those that are the same for every object.
+static void setMaterialUniforms(ShaderVariant* shader, int i) {
+    StageTimer timer(STAGE_UNIFORMS);
+
+    // Uniforms that are the same for every object only need setting once per
+    // frame in each shader variant.
+    if (shader->frameStamp != frameCount) {
+        shader->frameStamp = frameCount;
+        glUniformMatrix4fv(shader->projectionU, 1, GL_TRUE, projection);
+        glUniformMatrix4fv(shader->viewU, 1, GL_TRUE, view);
+        setLightClusterUniforms(shader, windowWidth, windowHeight);
+        setBonePaletteUniforms(shader);
 
-    dt = glutGet(GLUT_ELAPSED_TIME) - t;
+        // Texture 0 is the only texture type in this program, and is for the rgb colour of the
+        // surface but there could be separate types for, e.g., specularity and normals. 
+        glUniform1i(shader->textureU, 0); CheckError();
+    }
+
+    glUniform1f(shader->alphaU, objects.alpha[i] );
 
-    // Prevent calculations where vsync timing hasn't occured
-    // Note - this isn't true hardware vsync which communicates with the monitor,
-    // (normally set in GPU config) though the improvement will remove a large amount of screen tearing.
-    if(vsync && dt < 1000/Hz) return;
+    // The light colours are applied per light in the shader.
+    glUniform3fv(shader->materialColorU, 1, objects.rgb[i] * objects.brightness[i] ); CheckError();
+    glUniform1f(shader->ambientU, objects.ambient[i] );
+    glUniform1f(shader->diffuseU, objects.diffuse[i] );
+    glUniform1f(shader->specularU, objects.specular[i] );
+
+    glUniform1f(shader->shininessU, objects.shine[i] ); CheckError();
+}
+
+// What must match for objects to be drawn as instances of one draw call.
+static void drawState(int i, float state[13]) {
+    const vec3& rgb = objects.rgb[i];
+    float values[13] = { (float) objects.meshId[i], (float) objects.lod[i], (float) objects.texId[i],
+                         objects.texScale[i], objects.alpha[i], rgb.x, rgb.y, rgb.z, objects.brightness[i],
+                         objects.ambient[i], objects.diffuse[i], objects.specular[i], objects.shine[i] };
+    copy(values, values + 13, state);
+}
+
+static bool drawStateBefore(int a, int b) {
+    float sa[13], sb[13];
+    drawState(a, sa);
+    drawState(b, sb);
+    return lexicographical_compare(sa, sa + 13, sb, sb + 13);
+}
+
+static bool sameDrawState(int a, int b) {
+    return !drawStateBefore(a, b) && !drawStateBefore(b, a);
+}
+
+// The skinned objects to draw from baked clips this frame, sorted so that copies
+// which can share a draw call are together.
+static vector<int> crowd;
+
+// Write the crowd's instance data (model matrix and pose time), in crowd order.
+static void addCrowdInstances(float pose_time) {
+    sort(crowd.begin(), crowd.end(), drawStateBefore);
+    for (size_t c = 0; c < crowd.size(); c++)
+        addBakedInstance(modelMatrix(crowd[c], pose_time), poseTimeFor(crowd[c], pose_time));
+    uploadBakedInstances();
+}
+
+// Draw the crowd, one instanced draw call for each run of objects with the same
+// mesh, texture and material.
+static void drawCrowd() {
+    TraceZone zone("drawCrowd");
+    for (size_t first = 0, end; first < crowd.size(); first = end) {
+        for (end = first + 1; end < crowd.size() && sameDrawState(crowd[first], crowd[end]); end++)
+            ;
+        int i = crowd[first];
+        ShaderVariant* shader = useShaderVariant(shaderFeaturesFor(i) | SHADER_BAKED);
+        if (shader == NULL) {
+            continue; // Still compiling
+        }
+
+        setMaterialUniforms(shader, i);
+        {
+            StageTimer timer(STAGE_UNIFORMS);
+            bindTextureAndMesh(i, shader);
+            useBakedClip(shader, bakedClips[objects.meshId[i]], first);
+        }
+
+        StageTimer drawTimer(STAGE_DRAW);
+        int numFaces = meshes[objects.meshId[i]]->mNumFaces;
+        glDrawElementsInstanced(GL_TRIANGLES, numFaces * 3, GL_UNSIGNED_INT, NULL, end - first); CheckError();
+        frameStats.drawCalls++;
+        frameStats.triangles += numFaces * (end - first);
+    }
+}
+
+void display(void) {
+
+    // Frames are paced in idle(), so by now it's time to draw.
+    double now = frameTime();
+    beginFrameStats();
+    TraceZone zone("display");
 
     numDisplayCalls++;
-    animFrame = animFrame + 1;
+    frameCount++;
 
-    t = glutGet(GLUT_ELAPSED_TIME);
+    // Movement, jumping and animation advance in fixed steps; draw the state for now.
+    SimState sim;
+    {
+        StageTimer timer(STAGE_SIMULATION);
+        sim = sampleSimulation(now);
+    }
+    animFrame = sim.animFrame;
+
+    updateShaderCache(); // Pick up any shader variants that have finished compiling
 
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
     CheckError(); // May report a harmless GL_INVALID_OPERATION with GLEW on the first frame
@@ -654,93 +922,194 @@ void display(void) {
     // add appropriate rotations.
 
     if(gameMode) {
+        view = Translate(0.0, 0.0, 1) * RotateX(sim.pitch) * RotateY(sim.yaw) *
+               Translate(sim.dx, -sim.dy, sim.dz);
 
-        // High school trig for position deltas (warning: pen and paper required).
-        // Scaled by time delta and scaling factor afterwards.
-        if (runForward) {
-            dx -= sin(yaw*0.0174532925) * moveScale * dt;
-            dz += cos(yaw*0.0174532925) * moveScale * dt;
-        }
-        if (runBack) {
-            dx += sin(yaw*0.0174532925) * moveScale * dt;
-            dz -= cos(yaw*0.0174532925) * moveScale * dt;
-        }
-        if (strafeRight) {
-            dz -= sin(yaw*0.0174532925) * moveScale * dt;
-            dx -= cos(yaw*0.0174532925) * moveScale * dt;
-        }
-        if (strafeLeft) {
-            dz += sin(yaw*0.0174532925) * moveScale * dt;
-            dx += cos(yaw*0.0174532925) * moveScale * dt;
-        }
+    } else {
+        view = Translate(0.0, 0.0, 1-viewDist) * RotateX(camRotUpAndOverDeg) * RotateY(camRotSidewaysDeg);
+    }
 
-        // s = ut + (1/2)at^2
-        // Luckily we can deal with s' through incremental +=/-= operators.
-        // ds/dt = v = u + at
-        if (jump) {
-            dy += inertia * dt;
-            inertia -= gravity * dt;
-            if (dy < 1.5) {
-                jump = false;
-                dy = 1.5;
-                inertia = impulse;
+    // Gather the lights, directional ones first, and bin the point lights into clusters.
+    {
+        StageTimer timer(STAGE_LIGHTS);
+        static vector<Light> lights;
+        lights.clear();
+        for(int i=0; i<objects.count; i++) {
+            if (objects.light[i] == LIGHT_DIRECTIONAL) {
+                // Shines from the direction of the light object, as seen from the origin.
+                Light light;
+                vec4 loc = objects.loc[i];
+                light.eyePos = view * vec4(loc.x, loc.y, loc.z, 0.0);
+                light.color = objects.rgb[i] * objects.brightness[i];
+                light.radius = 0.0;
+                lights.push_back(light);
             }
         }
-
-        // Keyboard tilting isn't forgotten for those not using the mouse.
-        yaw -= yawLeft * turnScale * dt;
-        yaw += yawRight * turnScale * dt;
-        pitch -= pitchUp * turnScale * dt;
-        pitch += pitchDown * turnScale * dt;
-
-        // Limit the pitch to a single hemisphere to avoid nauseating effects of
-        // gimble-lock outside this range (gimble-lock at 90 and -90 is desired though).
-        if (pitch > 90) {
-            pitch = 90;
-        } else if (pitch < -90) {
-            pitch = -90;
+        int numDirectional = lights.size();
+        for(int i=0; i<objects.count; i++) {
+            if (objects.light[i] == LIGHT_POINT) {
+                Light light;
+                light.eyePos = view * objects.loc[i];
+                light.color = objects.rgb[i] * objects.brightness[i];
+                light.radius = pointLightRadius(light.color);
+                lights.push_back(light);
+            }
         }
-
-        view = Translate(0.0, 0.0, 1) * RotateX(pitch) * RotateY(yaw) * Translate(dx, -dy, dz);
-
-    } else {
-        view = Translate(0.0, 0.0, 1-viewDist) * RotateX(camRotUpAndOverDeg) * RotateY(camRotSidewaysDeg);
+        updateLightClusters(lights.data(), numDirectional, lights.size() - numDirectional,
+                            projection, nearDist, farDist);
+        bindLightClusters(); CheckError();
     }
 
-    SceneObject lightObj1 = sceneObjs[1]; 
-    vec4 lightPosition1 = view * lightObj1.loc;
+    // Choose the objects to draw: those not hidden whose bounds reach into the
+    // view.  Skinned objects' bounds hold every pose, and their model matrices
+    // include the walk along their path.  The stages after this one only visit
+    // the visible objects' indices, packed together.
+    static vector<int> visible;
+    static vector<vec4> visibleCentres; // Of each visible object's bounding sphere, in eye coordinates
+    static vector<float> visibleRadii;
+    bool animating = false;
+    {
+        StageTimer timer(STAGE_CULLING);
+        visible.clear();
+        visibleCentres.clear();
+        visibleRadii.clear();
+        vec4 planes[6];
+        frustumPlanes(projection, planes);
+        for(int i=0; i<objects.count; i++) {
+            if (objects.hidden[i]) {
+                continue;
+            }
+            int meshId = objects.meshId[i];
+            loadMeshIfNotAlreadyLoaded(meshId); CheckError();
+            if (meshes[meshId]->mNumBones > 0) {
+                animating = true; // Even out of view, as the walk may bring it back
+            }
 
-    SceneObject lightObj2 = sceneObjs[2]; 
-    vec4 lightPosition2 = view * lightObj2.loc;
+            const Bounds& bounds = drawnBounds(meshId);
+            vec4 centre = view * (modelMatrix(i, animFrame) * vec4(boundsCentre(bounds), 1.0));
+            float radius = boundsRadius(bounds) * objects.scale[i];
+            if (!sphereOutside(planes, centre, radius)) {
+                visible.push_back(i);
+                visibleCentres.push_back(centre);
+                visibleRadii.push_back(radius);
+            }
+        }
+    }
 
-    glUniform4fv(glGetUniformLocation(shaderProgram, "LightPosition1"), 1, lightPosition1); CheckError();
-    glUniform4fv(glGetUniformLocation(shaderProgram, "LightPosition2"), 1, lightPosition2); CheckError();
+    // Pose every visible skinned object before drawing anything, so the poses can
+    // be calculated together on the job threads rather than between draw calls.
+    // With baked animation, skinned objects go to the crowd and need no posing.
+    // Otherwise, objects in the lower animation tiers keep their last pose
+    // between updates, which the pose cache copies rather than recalculates.
+    static vector<int> poseOffsets; // Into posePalettes(), for each visible object, or -1
+    static vector<GLuint> skinnedVaos; // From the skinning pre-pass, for each visible object, or 0
+    const int inCrowd = -2;
+    {
+        StageTimer timer(STAGE_ANIMATION);
+        beginPoseCacheFrame();
+        crowd.clear();
+        poseOffsets.resize(visible.size());
+        for(size_t v=0; v<visible.size(); v++) {
+            int i = visible[v];
+            int meshId = objects.meshId[i];
+            poseOffsets[v] = -1;
+            if (meshes[meshId]->mNumBones > 0) {
+                AnimLod lod = ANIM_LOD_FULL;
+                if (animLod) {
+                    float pixels = projectedRadius(visibleCentres[v], visibleRadii[v], projection, windowHeight);
+                    lod = animLodFor(pixels);
+                }
+                // An object just added, back in view or changing tier has no
+                // pose to hold yet, so it's posed now rather than on its update frame.
+                bool stale = objects.lodFrame[i] == 0 || objects.lodFrame[i] + 1 != frameCount ||
+                             objects.lod[i] != lod;
+                objects.lod[i] = lod;
+                objects.lodFrame[i] = frameCount;
+                if (stale || animLodUpdates(lod, objects.slotOf[i], frameCount))
+                    objects.heldPoseTime[i] = poseTimeFor(i, animFrame);
+
+                if (bakedAnimation && !skeletons[meshId]->clips.empty()) {
+                    if (bakedClips[meshId] == NULL)
+                        bakedClips[meshId] = bakeClip(skeletons[meshId], 0);
+                    crowd.push_back(i);
+                    poseOffsets[v] = inCrowd;
+                } else {
+                    poseOffsets[v] = requestPose(meshId, skeletons[meshId], 0, objects.heldPoseTime[i]);
+                }
+            }
+        }
+        calculatePoses();
+        uploadBonePalettes(posePalettes(), posePalettesSize());
+        bindBonePalettes();
+        addCrowdInstances(animFrame);
+
+        // With the pre-pass, each distinct pose is skinned once here, and the
+        // objects are drawn from the results by the unskinned variants.
+        skinnedVaos.assign(visible.size(), 0);
+        if (prepassSkinning) {
+            beginSkinPrepass();
+            for(size_t v=0; v<visible.size(); v++) {
+                if (poseOffsets[v] < 0) {
+                    continue;
+                }
+                int i = visible[v];
+                skinnedVaos[v] = skinPrepass(prepassMeshes[objects.meshId[i]], paletteBase(poseOffsets[v]),
+                                             objects.lod[i]);
+            }
+            endSkinPrepass();
+        }
+    }
 
-    for(int i=0; i<nObjects; i++) {
-        SceneObject so = sceneObjs[i];
+    for(size_t v=0; v<visible.size(); v++) {
+        int i = visible[v];
+        if (poseOffsets[v] == inCrowd) {
+            continue; // Drawn below
+        }
 
-        if (hidden[i]) {
-          continue;
+        unsigned features = shaderFeaturesFor(i);
+        GLuint skinnedVao = skinnedVaos[v];
+        if (skinnedVao != 0) {
+            features &= ~(SHADER_SKINNED | SHADER_REDUCED_BONES);
+        }
+        ShaderVariant* shader = useShaderVariant(features);
+        if (shader == NULL) {
+          continue; // Nothing that can draw this object has finished compiling
+        }
+        if (shader->features & SHADER_SKINNED) {
+            skinnedVao = 0; // A skinned variant is standing in, so it skins the mesh itself
         }
 
-        glUniform1f(glGetUniformLocation(shaderProgram, "Alpha"), so.alpha );
+        setMaterialUniforms(shader, i);
 
-        vec3 rgb1 = so.rgb * lightObj1.rgb * so.brightness * lightObj1.brightness;
-        glUniform3fv(glGetUniformLocation(shaderProgram, "AmbientProduct1"), 1, so.ambient * rgb1 ); CheckError();
-        glUniform3fv(glGetUniformLocation(shaderProgram, "DiffuseProduct1"), 1, so.diffuse * rgb1 );
-        glUniform3fv(glGetUniformLocation(shaderProgram, "SpecularProduct1"), 1, so.specular * rgb1 );
+        drawMesh(i, animFrame, paletteBase(poseOffsets[v]), skinnedVao, shader);
+    }
+    drawCrowd();
 
-        vec3 rgb2 = so.rgb * lightObj2.rgb * so.brightness * lightObj2.brightness;
-        glUniform3fv(glGetUniformLocation(shaderProgram, "AmbientProduct2"), 1, so.ambient * rgb2 ); CheckError();
-        glUniform3fv(glGetUniformLocation(shaderProgram, "DiffuseProduct2"), 1, so.diffuse * rgb2 );
-        glUniform3fv(glGetUniformLocation(shaderProgram, "SpecularProduct2"), 1, so.specular * rgb2 );
+    if (showFrameGraph) {
+        drawFrameGraph(windowWidth, windowHeight);
+    }
 
-        glUniform1f(glGetUniformLocation(shaderProgram, "Shininess"), so.shine ); CheckError();
+    {
+        StageTimer timer(STAGE_SWAP);
+        if (headless) {
+            glFinish(); // Wait for the frame to be drawn, as swapping would
+        } else {
+            glutSwapBuffers();
+        }
+    }
+    endFrameStats();
 
-        drawMesh(sceneObjs[i], animFrame);
+    if (headless) {
+        return; // There's no idle callback to manage
     }
 
-    glutSwapBuffers();
+    // Stop redrawing once nothing is changing by itself.
+    bool moving = gameMode && (runForward || runBack || strafeLeft || strafeRight || sim.jumping ||
+                               yawLeft || yawRight || pitchUp || pitchDown);
+    if (!moving && !animating && !simInputPending() && !shaderVariantsPending()) {
+        glutIdleFunc(NULL);
+        idleRegistered = false;
+    }
 
 }
 
@@ -753,47 +1122,63 @@ static void objectMenu(int id) {
 
 static void texMenu(int id) {
     deactivateTool();
-    if(currObject>=0) {
-        sceneObjs[currObject].texId = id;
-        glutPostRedisplay();
+    int i = objectIndex(objects, currObject);
+    if(i>=0) {
+        objects.texId[i] = id;
+        requestRedraw();
     }
 }
 
 static void groundMenu(int id) {
         deactivateTool();
-        sceneObjs[0].texId = id;
-        glutPostRedisplay();
+        objects.texId[objectIndex(objects, ground)] = id;
+        requestRedraw();
 }
 
-static void adjustBrightnessY(vec2 by) 
-  { sceneObjs[toolObj].brightness+=by[0]; sceneObjs[toolObj].loc[1]+=by[1]; }
+// The mouse tools below adjust toolObj, unless it's been deleted.
+static void adjustBrightnessY(vec2 by) {
+  int i = objectIndex(objects, toolObj);
+  if (i >= 0) { objects.brightness[i]+=by[0]; objects.loc[i][1]+=by[1]; }
+}
 
-static void adjustRedGreen(vec2 rg) 
-  { sceneObjs[toolObj].rgb[0]+=rg[0]; sceneObjs[toolObj].rgb[1]+=rg[1]; }
+static void adjustRedGreen(vec2 rg) {
+  int i = objectIndex(objects, toolObj);
+  if (i >= 0) { objects.rgb[i][0]+=rg[0]; objects.rgb[i][1]+=rg[1]; }
+}
 
-static void adjustBlueBrightness(vec2 bl_br) 
-  { sceneObjs[toolObj].rgb[2]+=bl_br[0]; sceneObjs[toolObj].brightness+=bl_br[1]; }
+static void adjustBlueBrightness(vec2 bl_br) {
+  int i = objectIndex(objects, toolObj);
+  if (i >= 0) { objects.rgb[i][2]+=bl_br[0]; objects.brightness[i]+=bl_br[1]; }
+}
 
   static void lightMenu(int id) {
     deactivateTool();
     if(id == 70) {
-	    toolObj = 1;
+	    toolObj = firstLight;
         setToolCallbacks(adjustLocXZ, camRotZ(),
                          adjustBrightnessY, mat2( 1.0, 0.0, 0.0, 10.0) );
 
     } else if(id>=71 && id<=74) {
-	    toolObj = 1;
+	    toolObj = firstLight;
         setToolCallbacks(adjustRedGreen, mat2(1.0, 0, 0, 1.0),
                          adjustBlueBrightness, mat2(1.0, 0, 0, 1.0) );
     } else if(id == 80) {
-        toolObj = 2;
+        toolObj = secondLight;
         setToolCallbacks(adjustLocXZ, camRotZ(),
                          adjustBrightnessY, mat2( 1.0, 0.0, 0.0, 10.0) );
 
     } else if(id>=81 && id<=84) {
-        toolObj = 2;
+        toolObj = secondLight;
         setToolCallbacks(adjustRedGreen, mat2(1.0, 0, 0, 1.0),
                          adjustBlueBrightness, mat2(1.0, 0, 0, 1.0) );
+
+    } else if(id == 90) {
+        // A new point light.  Like any object it's adjusted via the main menu once selected.
+        int i = addObject(55);
+        objects.scale[i] = 0.1;
+        objects.texId[i] = 0; // Plain texture
+        objects.brightness[i] = 0.8;
+        objects.light[i] = LIGHT_POINT;
     }
 
     else { printf("Error in lightMenu\n"); exit(1); }
@@ -819,22 +1204,28 @@ static int createArrayMenu(int size, const char menuEntries[][128], void(*menuFn
 }
 
 static void adjustAmbientDiffuse(vec2 ad) {
-  sceneObjs[toolObj].ambient += ad[0];
-  sceneObjs[toolObj].diffuse += ad[1];
+  int i = objectIndex(objects, toolObj);
+  if (i < 0) return;
+  objects.ambient[i] += ad[0];
+  objects.diffuse[i] += ad[1];
 }
 
 static void adjustSpecularShine(vec2 ss) {
-  sceneObjs[toolObj].specular += ss[0];
-  sceneObjs[toolObj].shine += ss[1] * 10;
+  int i = objectIndex(objects, toolObj);
+  if (i < 0) return;
+  objects.specular[i] += ss[0];
+  objects.shine[i] += ss[1] * 10;
 }
 
 static void adjustAlpha(vec2 by) {
-  sceneObjs[toolObj].alpha += by[0];
+  int i = objectIndex(objects, toolObj);
+  if (i < 0) return;
+  objects.alpha[i] += by[0];
 }
 
 static void materialMenu(int id) {
   deactivateTool();
-  if(currObject<0) return;
+  if(objectIndex(objects, currObject)<0) return;
 
   if(id==10) {
     toolObj = currObject;
@@ -857,29 +1248,35 @@ static void materialMenu(int id) {
   else { printf("Error in materialMenu\n"); }
 }
 
+// Step through the objects in index order, which deleting an object rearranges.
 static void selectMenu(int id) {
+  int i = objectIndex(objects, toolObj);
   if (id == 2) {
-    toolObj++;
+    i++;
 
-    if (toolObj == nObjects) {
-      toolObj = 0;
+    if (i == objects.count) {
+      i = 0;
     }
   } else {
-    if (toolObj == 0) {
-      toolObj = nObjects - 1;
+    if (i <= 0) {
+      i = objects.count - 1;
     } else {
-      toolObj--;
+      i--;
     }
   }
 
-  currObject = toolObj;
+  toolObj = currObject = objectHandle(objects, i);
 }
 
-static void adjustAngleYX(vec2 angle_yx) 
-  {  sceneObjs[currObject].angles[1]+=angle_yx[0]; sceneObjs[currObject].angles[0]+=angle_yx[1]; }
+static void adjustAngleYX(vec2 angle_yx) {
+  int i = objectIndex(objects, currObject);
+  if (i >= 0) { objects.angles[i][1]+=angle_yx[0]; objects.angles[i][0]+=angle_yx[1]; }
+}
 
-static void adjustAngleZTexscale(vec2 az_ts) 
-  {  sceneObjs[currObject].angles[2]+=az_ts[0]; sceneObjs[currObject].texScale+=az_ts[1]; }
+static void adjustAngleZTexscale(vec2 az_ts) {
+  int i = objectIndex(objects, currObject);
+  if (i >= 0) { objects.angles[i][2]+=az_ts[0]; objects.texScale[i]+=az_ts[1]; }
+}
 
 static void adjustAnim(vec2 dist_speed) {
     animDistance += dist_speed[0] * 10.0;
@@ -897,7 +1294,9 @@ static void adjustAnim(vec2 dist_speed) {
 
 static void mainmenu(int id) {
     deactivateTool();
-    if(id == 41 && currObject>=0) {
+    int curr = objectIndex(objects, currObject);
+    int tool = objectIndex(objects, toolObj);
+    if(id == 41 && curr>=0) {
 	    toolObj=currObject;
         setToolCallbacks(adjustLocXZ, camRotZ(),
                          adjustScaleY, mat2(0.05, 0, 0, 10) );
@@ -907,20 +1306,24 @@ static void mainmenu(int id) {
     }
     if(id == 50)
         doRotate();
-    if(id == 55 && currObject>=0) {
+    if(id == 55 && curr>=0) {
         setToolCallbacks(adjustAngleYX, mat2(400, 0, 0, -400),
                          adjustAngleZTexscale, mat2(400, 0, 0, 15) );
     }
-    if (id == 56) {
-      hidden[toolObj] = 1;
+    if (id == 56 && tool>=0) {
+      objects.hidden[tool] = 1;
     }
-    if (id == 57) {
-      hidden[toolObj] = 0;
+    if (id == 57 && tool>=0) {
+      objects.hidden[tool] = 0;
     }
-    if (id == 58) {
-        sceneObjs[nObjects] = sceneObjs[currObject];
-
-        toolObj = currObject = nObjects++;
+    if (id == 58 && curr>=0) {
+        toolObj = currObject = copySceneObject(&objects, curr);
+    }
+    // The ground and the two lights the Lights menu adjusts can't be deleted.
+    if (id == 59 && curr>=0 && !sameObject(currObject, ground) &&
+        !sameObject(currObject, firstLight) && !sameObject(currObject, secondLight)) {
+        removeSceneObject(&objects, currObject);
+        toolObj = currObject = noObject;
     }
 
     if(id == 65) {
@@ -933,6 +1336,8 @@ static void mainmenu(int id) {
     }
 
     if(id == 99) exit(0);
+
+    requestRedraw(); // Hiding, unhiding and duplicating change the scene
 }
 
 static void makeMenu() {
@@ -951,6 +1356,7 @@ static void makeMenu() {
   glutAddMenuEntry("R/G/B/All Light 1",71);
   glutAddMenuEntry("Move Light 2",80);
   glutAddMenuEntry("R/G/B/All Light 2",81);
+  glutAddMenuEntry("Add Point Light",90);
 
   selectMenuId = glutCreateMenu(selectMenu);
   glutAddMenuEntry("Previous Object", 1);
@@ -962,6 +1368,7 @@ static void makeMenu() {
   glutAddSubMenu("Add object", objectId);
   glutAddSubMenu("Select object", selectMenuId);
   glutAddMenuEntry("Duplicate object", 58);
+  glutAddMenuEntry("Delete object", 59);
   glutAddMenuEntry("Hide object", 56);
   glutAddMenuEntry("Unide object", 57);
   glutAddMenuEntry("Position/Scale", 41);
@@ -982,6 +1389,8 @@ static void makeMenu() {
 void
 normalKeyboardDown( unsigned char key, int x, int y )
 {
+    StageTimer timer(STAGE_INPUT);
+
     // Looked up all of these on an ASCII chart initially.
     // That would have looked silly.
     switch ( key ) {
@@ -998,6 +1407,8 @@ normalKeyboardDown( unsigned char key, int x, int y )
         strafeRight = true;
         break;
     }
+    updateSimInput();
+    requestRedraw();
 }
 
 
@@ -1006,6 +1417,8 @@ normalKeyboardDown( unsigned char key, int x, int y )
 void
 specialKeyboardDown( int key, int x, int y )
 {
+    StageTimer timer(STAGE_INPUT);
+
     switch ( key ) {
     case GLUT_KEY_UP:
         pitchUp = true;
@@ -1036,6 +1449,8 @@ specialKeyboardDown( int key, int x, int y )
         }
         break;
     }
+    updateSimInput();
+    requestRedraw();
 }
 
 //----------------------------------------------------------------------------
@@ -1043,6 +1458,8 @@ specialKeyboardDown( int key, int x, int y )
 void
 normalKeyboardUp( unsigned char key, int x, int y )
 {
+    StageTimer timer(STAGE_INPUT);
+
     switch ( key ) {
     case 'w':
         runForward = false;
@@ -1058,6 +1475,7 @@ normalKeyboardUp( unsigned char key, int x, int y )
         break;
     case 'v':
         vsync = !vsync;
+        setFramePacerVsync(vsync);
         break;
     case 'g':
         switchMode();
@@ -1065,13 +1483,37 @@ normalKeyboardUp( unsigned char key, int x, int y )
     case 'f':
         toggleFullScreen();
         break;
+    case 't':
+        showFrameGraph = !showFrameGraph;
+        break;
+    case 'c':
+        if (writeFrameStatsCsv("frame-stats.csv")) {
+            printf("Saved the last %d frames to frame-stats.csv\n", frameHistoryCount());
+        } else {
+            printf("Couldn't write frame-stats.csv\n");
+        }
+        break;
+    case 'r':
+        toggleTracing();
+        break;
+    case 'b':
+        bakedAnimation = !bakedAnimation;
+        break;
+    case 'l':
+        animLod = !animLod;
+        break;
+    case 'k':
+        prepassSkinning = !prepassSkinning;
+        break;
     case ' ':
-        jump = true;
+        startSimJump();
         break;
     case 27:
         exit( EXIT_SUCCESS );
         break;
     }
+    updateSimInput();
+    requestRedraw();
 }
 
 
@@ -1080,6 +1522,8 @@ normalKeyboardUp( unsigned char key, int x, int y )
 void
 specialKeyboardUp( int key, int x, int y )
 {
+    StageTimer timer(STAGE_INPUT);
+
     switch ( key ) {
     case GLUT_KEY_LEFT:
         yawLeft = false;
@@ -1094,12 +1538,15 @@ specialKeyboardUp( int key, int x, int y )
         pitchDown = false;
         break;
     }
+    updateSimInput();
+    requestRedraw();
 }
 
 //----------------------------------------------------------------------------
 
 
 void idle( void ) {
+  waitForNextFrame(); // Sleep, rather than spin, until the next frame is due
   glutPostRedisplay();
 }
 
@@ -1112,8 +1559,9 @@ void timer(int unused)
     } else {
         sprintf(prefix, "VSYNC OFF -- ");
     }
-    sprintf(title, "%s %s %s: %d Frames Per Second @ %d x %d", prefix,
-            lab, programName, numDisplayCalls, windowWidth, windowHeight );
+    sprintf(title, "%s %s %s: %d Frames Per Second @ %d x %d, CPU %.0f%%", prefix,
+            lab, programName, numDisplayCalls, windowWidth, windowHeight,
+            framePacerCpuPercent() );
 
     glutSetWindowTitle(title);
 
@@ -1122,6 +1570,193 @@ void timer(int unused)
 }
 
 
+// Replace the test mesh with the bench scene's objects, laid out on a grid over the
+// ground, and scatter its point lights.
+static void addBenchObjects(const BenchScene& bench) {
+    // Keep the ground and the two starting lights.  Going down, whatever is
+    // moved into a deleted object's place has already been kept.
+    for (int i = objects.count - 1; i >= 0; i--) {
+        ObjectHandle handle = objectHandle(objects, i);
+        if (!sameObject(handle, ground) && !sameObject(handle, firstLight) && !sameObject(handle, secondLight))
+            removeSceneObject(&objects, handle);
+    }
+
+    int numPlaced = 0;
+    for (size_t i = 0; i < bench.objects.size(); i++)
+        numPlaced += bench.objects[i].count;
+
+    int placed = 0;
+    int side = (int) ceil(sqrt((float) max(numPlaced, 1)));
+    float spacing = 16.0 / side;
+    for (size_t i = 0; i < bench.objects.size(); i++) {
+        for (int j = 0; j < bench.objects[i].count; j++, placed++) {
+            int o = addObject(bench.objects[i].meshId);
+            objects.texId[o] = bench.objects[i].texId;
+            objects.loc[o] = vec4(-8.0 + spacing * (placed % side + 0.5), 0.0,
+                                  -8.0 + spacing * (placed / side + 0.5), 1.0);
+            objects.angles[o][1] = (placed * 37) % 360;
+            objects.animOffset[o] = (placed * 13) % 50; // Out of step, like a real crowd
+        }
+    }
+
+    for (int i = 0; i < bench.numLights; i++) {
+        int o = addObject(55);
+        objects.loc[o] = vec4(rand() % 180 / 10.0 - 9.0, 0.3 + rand() % 17 / 10.0,
+                              rand() % 180 / 10.0 - 9.0, 1.0);
+        objects.scale[o] = 0.05;
+        objects.texId[o] = 0;
+        objects.rgb[o] = vec3(0.3 + rand() % 8 / 10.0, 0.3 + rand() % 8 / 10.0,
+                              0.3 + rand() % 8 / 10.0);
+        objects.brightness[o] = 0.5;
+        objects.light[o] = LIGHT_POINT;
+    }
+}
+
+// Draw a fixed number of frames into the headless framebuffer, optionally saving each
+// one as <savePrefix>NNNN.bmp, and report the time taken.  With a bench scene the
+// camera follows a scripted path and the measured frames are reported as JSON.
+static void runHeadless(int frames, const char* savePrefix,
+                        const char* benchFile, const char* benchOut) {
+    BenchScene bench;
+    int warmup = 0;
+    if (benchFile != NULL) {
+        if (!loadBenchScene(benchFile, numMeshes, numTextures, &bench)) exit(1);
+        addBenchObjects(bench);
+        if (frames < 0) frames = bench.frames;
+        warmup = bench.warmup;
+    }
+    if (frames < 0) frames = 100;
+
+    while (shaderVariantsPending())
+        updateShaderCache(); // So every frame is drawn with the same shaders
+
+    if (benchFile != NULL && bench.walk) {
+        // Walk forwards while turning, which goes round in a circle.
+        gameMode = true;
+        runForward = yawRight = true;
+        updateSimInput();
+    }
+
+    initSimulation(0.0, false); // Frame times come from frameTime()
+    reshape(windowWidth, windowHeight);
+
+    vector<FrameStats> measured;
+    double start = monotonicSeconds();
+    for (headlessFrame = 0; headlessFrame < warmup + frames; headlessFrame++) {
+        int frame = headlessFrame - warmup;
+        if (benchFile != NULL && !bench.walk) {
+            camRotSidewaysDeg = 360.0 * frame / frames; // One orbit over the measured frames
+            camRotUpAndOverDeg = 20.0;
+        }
+        display();
+        if (frame >= 0)
+            measured.push_back(lastFrameStats());
+        if (savePrefix != NULL) {
+            char filename[1024];
+            snprintf(filename, sizeof filename, "%s%04d.bmp", savePrefix, headlessFrame);
+            saveHeadlessFrame(filename);
+        }
+    }
+    double elapsed = monotonicSeconds() - start;
+
+    printf("Headless: %d frames in %.3f s, %.3f ms per frame\n", warmup + frames, elapsed,
+           warmup + frames > 0 ? elapsed * 1000.0 / (warmup + frames) : 0.0);
+
+    if (benchFile != NULL)
+        writeBenchReport(benchOut, benchFile, bench, windowWidth, windowHeight, measured);
+    if (traceEnabled)
+        toggleTracing();
+}
+
+// Load every model and texture serially, then again on the job threads, and report the
+// time and memory each takes (see import-bench.h).  Runs instead of init(), so that
+// nothing is loaded beforehand, and without aiInit's logging, which isn't thread-safe.
+static void runImportBench(const char* reportFile, const char* sortColumn) {
+    glGenVertexArrays(numMeshes, vaoIDs); CheckError();
+    glGenTextures(numTextures, textureIDs); CheckError();
+    initJobs();
+
+    vector<AssetStats> assets(numMeshes + numTextures);
+    ImportTotals totals;
+    memset(&totals, 0, sizeof totals);
+    memset(&assets[0], 0, sizeof(AssetStats) * assets.size());
+
+    for (int i = 0; i < numMeshes; i++) {
+        AssetStats& a = assets[i];
+        snprintf(a.name, sizeof a.name, "model%d.x", i);
+        a.isMesh = true;
+        scenes[i] = loadSceneInSteps(i, &a.parseMs, &a.postMs);
+        if (scenes[i] == NULL) fail("Error loading model:", a.name);
+        meshes[i] = scenes[i]->mMeshes[0];
+
+        double start = monotonicSeconds();
+        uploadMesh(i);
+        glFinish();
+        a.uploadMs = (monotonicSeconds() - start) * 1000.0;
+
+        aiMesh* mesh = meshes[i];
+        a.vertices = mesh->mNumVertices;
+        a.faces = mesh->mNumFaces;
+        a.bones = mesh->mNumBones;
+        aiMemoryInfo memory;
+        aiGetMemoryRequirements(scenes[i], &memory);
+        a.cpuBytes = memory.total;
+        a.gpuBytes = (long) mesh->mNumVertices * (9*sizeof(float) + 4*sizeof(GLint) + 4*sizeof(GLfloat))
+                     + (long) mesh->mNumFaces * 3 * sizeof(GLuint);
+
+        totals.serialLoadMs += a.parseMs + a.postMs;
+        totals.serialUploadMs += a.uploadMs;
+    }
+
+    for (int i = 0; i < numTextures; i++) {
+        AssetStats& a = assets[numMeshes + i];
+        snprintf(a.name, sizeof a.name, "texture%d.bmp", i);
+        double start = monotonicSeconds();
+        textures[i] = loadTextureNum(i);
+        a.parseMs = (monotonicSeconds() - start) * 1000.0;
+
+        start = monotonicSeconds();
+        uploadTexture(i);
+        glFinish();
+        a.uploadMs = (monotonicSeconds() - start) * 1000.0;
+
+        a.width = textures[i]->width;
+        a.height = textures[i]->height;
+        a.cpuBytes = (long) a.width * a.height * 3;
+        a.gpuBytes = a.cpuBytes * 4 / 3;  // With the mipmaps
+
+        totals.serialLoadMs += a.parseMs;
+        totals.serialUploadMs += a.uploadMs;
+    }
+
+    // The same again on every thread, keeping the results only long enough to free them.
+    vector<const aiScene*> poolScenes(numMeshes);
+    vector<texture*> poolTextures(numTextures);
+    double start = monotonicSeconds();
+    parallelFor(numMeshes + numTextures, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (i < numMeshes)
+                poolScenes[i] = loadScene(i);
+            else
+                poolTextures[i - numMeshes] = loadTextureNum(i - numMeshes);
+        }
+    });
+    totals.poolLoadMs = (monotonicSeconds() - start) * 1000.0;
+    totals.poolThreads = numJobThreads();
+    for (int i = 0; i < numMeshes; i++)
+        aiReleaseImport(poolScenes[i]);
+    for (int i = 0; i < numTextures; i++) {
+        free(poolTextures[i]->rgbData);
+        free(poolTextures[i]);
+    }
+
+    sortAssetStats(assets, sortColumn);
+    printf("\n");
+    printImportTable(assets, totals);
+    if (writeImportReport(reportFile, assets, totals))
+        printf("Import bench: wrote %s\n", reportFile);
+}
+
 void fileErr(char* fileName) {
     printf("Error reading file: %s\n\n", fileName);
 
@@ -1136,6 +1771,8 @@ void fileErr(char* fileName) {
 
 int main( int argc, char* argv[] )
 {
+    setTraceThreadName("main");
+
     // Get the program name, excluding the directory, for the window title
     programName = argv[0];
     for(char *cpointer = argv[0]; *cpointer != 0; cpointer++)
@@ -1144,15 +1781,88 @@ int main( int argc, char* argv[] )
     // Set the models-textures directory, via the first argument or some handy defaults.
     if(!opendir(dataDir)) fileErr(dataDir);
 
-    glutInit( &argc, argv );
-    glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
-    glutInitWindowSize( windowWidth, windowHeight );
+    // glutInit needs a display, so a headless run has to be spotted before it.
+    for(int i=1; i<argc; i++)
+        if(strcmp(argv[i], "--headless") == 0 || strcmp(argv[i], "--bench") == 0
+           || strcmp(argv[i], "--import-bench") == 0) headless = true;
+
+    if (!headless) {
+        glutInit( &argc, argv );
+        glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
+        glutInitWindowSize( windowWidth, windowHeight );
+
+        glutInitContextVersion(3, 2);
+#ifndef NDEBUG
+        glutInitContextFlags( GLUT_DEBUG ); // So the driver reports everything to debug output
+#endif
+        //glutInitContextProfile( GLUT_CORE_PROFILE );        // May cause issues, sigh, but you
+        glutInitContextProfile( GLUT_COMPATIBILITY_PROFILE ); // should still use only OpenGL 3.2 Core
+                                                              // features.
+        glutCreateWindow( "Initialising..." );
+    }
 
-    glutInitContextVersion(3, 2);
-    //glutInitContextProfile( GLUT_CORE_PROFILE );        // May cause issues, sigh, but you
-    glutInitContextProfile( GLUT_COMPATIBILITY_PROFILE ); // should still use only OpenGL 3.2 Core
-                                                          // features.
-    glutCreateWindow( "Initialising..." );
+    // Options left over once glutInit has taken its own.
+    bool simThreaded = false;
+    int headlessFrames = -1; // 100, or as the bench scene says
+    const char* savePrefix = NULL;
+    const char* benchFile = NULL;
+    const char* benchOut = "-";
+    const char* importReport = NULL;
+    const char* importSort = "total";
+    for(int i=1; i<argc; i++) {
+        if(strcmp(argv[i], "--fps") == 0 && i+1 < argc)
+            setFramePacerTarget(atof(argv[++i]));
+        else if(strcmp(argv[i], "--sim-thread") == 0)
+            simThreaded = true;
+        else if(strcmp(argv[i], "--headless") == 0 && i+1 < argc
+                && sscanf(argv[++i], "%dx%d", &windowWidth, &windowHeight) == 2)
+            ;
+        else if(strcmp(argv[i], "--frames") == 0 && i+1 < argc)
+            headlessFrames = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--save-frames") == 0 && i+1 < argc)
+            savePrefix = argv[++i];
+        else if(strcmp(argv[i], "--bench") == 0 && i+1 < argc)
+            benchFile = argv[++i];
+        else if(strcmp(argv[i], "--bench-out") == 0 && i+1 < argc)
+            benchOut = argv[++i];
+        else if(strcmp(argv[i], "--import-bench") == 0 && i+1 < argc)
+            importReport = argv[++i];
+        else if(strcmp(argv[i], "--sort") == 0 && i+1 < argc) {
+            vector<AssetStats> none;
+            importSort = argv[++i];
+            if (!sortAssetStats(none, importSort)) {
+                printf("Unknown --sort column: %s\n", importSort);
+                exit(1);
+            }
+        }
+        else if(strcmp(argv[i], "--trace") == 0)
+            setTracing(true);
+        else if(strcmp(argv[i], "--baked-anim") == 0)
+            bakedAnimation = true;
+        else if(strcmp(argv[i], "--compress-anim") == 0)
+            compressAnimation = true;
+        else if(strcmp(argv[i], "--skin-prepass") == 0)
+            prepassSkinning = true;
+        else if(strcmp(argv[i], "--gl-debug") == 0 && i+1 < argc && parseDebugLevel(argv[i+1], &glDebugLevel))
+            i++;
+        else {
+            printf("Unknown option: %s\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    if (importReport != NULL) {
+        if (!initHeadless(64, 64)) exit(1);
+        runImportBench(importReport, importSort);
+        return 0;
+    }
+
+    if (headless) {
+        if (!initHeadless(windowWidth, windowHeight)) exit(1);
+        init(); CheckError();
+        runHeadless(headlessFrames, savePrefix, benchFile, benchOut);
+        return 0;
+    }
 
     glewInit(); // With some old hardware yields GL_INVALID_ENUM, if so use glewExperimental.
     CheckError(); // This bug is explained at: http://www.opengl.org/wiki/OpenGL_Loading_Library
@@ -1160,13 +1870,15 @@ int main( int argc, char* argv[] )
     makeMenu(); CheckError();
 
     init(); CheckError(); // Use CheckError after an OpenGL command to print any errors.
+    initFramePacer();
+    initSimulation(monotonicSeconds(), simThreaded);
 
     glutDisplayFunc(display);
     glutKeyboardFunc(normalKeyboardDown);
     glutSpecialFunc(specialKeyboardDown);
     glutKeyboardUpFunc(normalKeyboardUp);
     glutSpecialUpFunc(specialKeyboardUp); 
-    glutIdleFunc(idle);
+    requestRedraw(); // Registers idle for the first frame
 
     glutMouseFunc( mouseClickOrScroll );
     glutPassiveMotionFunc(mousePassiveMotion);
@@ -0,0 +1,78 @@
+#include "scene-store.h"
+
+// Every per-object array, so they can be grown, copied and shrunk together.
+#define FIELDS(F) \
+    F(loc) F(scale) F(angles) F(animOffset) F(meshId) F(texId) F(texScale) \
+    F(rgb) F(brightness) F(alpha) F(diffuse) F(specular) F(ambient) F(shine) \
+    F(light) F(hidden) F(lod) F(heldPoseTime) F(lodFrame) \
+    F(slotOf)
+
+// Make room for one more object (with every field zero), and give it a slot.
+static ObjectHandle appendObject(SceneStore* store) {
+    int index = store->count++;
+#define GROW(field) store->field.resize(store->count);
+    FIELDS(GROW)
+#undef GROW
+
+    unsigned slot;
+    if (!store->freeSlots.empty()) {
+        slot = store->freeSlots.back();
+        store->freeSlots.pop_back();
+    } else {
+        slot = store->slotIndex.size();
+        store->slotIndex.push_back(-1);
+        store->slotGeneration.push_back(0);
+    }
+    store->slotIndex[slot] = index;
+    store->slotOf[index] = slot;
+
+    ObjectHandle handle = { slot, store->slotGeneration[slot] };
+    return handle;
+}
+
+ObjectHandle addSceneObject(SceneStore* store) {
+    return appendObject(store);
+}
+
+ObjectHandle copySceneObject(SceneStore* store, int index) {
+    ObjectHandle handle = appendObject(store);
+    int copy = store->count - 1;
+#define COPY(field) store->field[copy] = store->field[index];
+    FIELDS(COPY)
+#undef COPY
+    store->slotOf[copy] = handle.slot;
+    return handle;
+}
+
+void removeSceneObject(SceneStore* store, ObjectHandle handle) {
+    int index = objectIndex(*store, handle);
+    if (index < 0) return;
+
+    int last = store->count - 1;
+    if (index != last) {
+#define MOVE(field) store->field[index] = store->field[last];
+        FIELDS(MOVE)
+#undef MOVE
+        store->slotIndex[store->slotOf[index]] = index;
+    }
+    store->count = last;
+#define SHRINK(field) store->field.resize(last);
+    FIELDS(SHRINK)
+#undef SHRINK
+
+    store->slotIndex[handle.slot] = -1;
+    store->slotGeneration[handle.slot]++;
+    store->freeSlots.push_back(handle.slot);
+}
+
+int objectIndex(const SceneStore& store, ObjectHandle handle) {
+    if (handle.slot >= store.slotIndex.size() || store.slotGeneration[handle.slot] != handle.generation)
+        return -1;
+    return store.slotIndex[handle.slot];
+}
+
+ObjectHandle objectHandle(const SceneStore& store, int index) {
+    unsigned slot = store.slotOf[index];
+    ObjectHandle handle = { slot, store.slotGeneration[slot] };
+    return handle;
+}
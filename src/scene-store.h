@@ -0,0 +1,79 @@
+// ------ Scene object store ----------------------------------------------------
+//
+// The scene's objects, kept as a structure of arrays: one array per field,
+// each holding that field for every object, packed into [0, count).  A loop
+// over the objects then reads only the fields it uses (the light gathering
+// only reads light types until it finds a light; culling reads placements),
+// rather than stepping over whole objects.  The arrays grow as needed, so
+// there's no limit on the number of objects.
+//
+// Removing an object moves the last one into its place, so indices change.
+// Anything that needs to keep referring to an object (the current object, the
+// one the mouse tools adjust) keeps a handle instead: a slot in a table that
+// follows the object to its index, and the slot's generation when the handle
+// was made.  A slot's generation counts up when its object is removed, so
+// handles to removed objects are found to be stale even after the slot has
+// been reused.
+
+#ifndef SCENE_STORE_H
+#define SCENE_STORE_H
+
+#include "Angel.h"
+#include "anim-lod.h"
+
+#include <vector>
+
+typedef struct {
+    unsigned slot;
+    unsigned generation;
+} ObjectHandle;
+
+const ObjectHandle noObject = { ~0u, 0 };
+
+inline bool sameObject(ObjectHandle a, ObjectHandle b) {
+    return a.slot == b.slot && a.generation == b.generation;
+}
+
+// Fields added here must be added to FIELDS in scene-store.cpp too.
+typedef struct {
+    int count;
+
+    std::vector<vec4> loc;
+    std::vector<float> scale;
+    std::vector<vec3> angles;               // Rotations around the X, Y and Z axes
+    std::vector<float> animOffset;          // Added to the animation time, so copies of a model needn't move in step
+    std::vector<int> meshId, texId;
+    std::vector<float> texScale;
+    std::vector<vec3> rgb;
+    std::vector<float> brightness;          // Multiplies all colours
+    std::vector<float> alpha;
+    std::vector<float> diffuse, specular, ambient; // Amount of each light component
+    std::vector<float> shine;
+    std::vector<int> light;                 // A LightType (see lights.h) - LIGHT_NONE for ordinary objects
+    std::vector<unsigned char> hidden;
+    std::vector<AnimLod> lod;               // A skinned object's animation tier, chosen every frame
+    std::vector<float> heldPoseTime;        // A skinned object's pose time when it was last posed
+    std::vector<int> lodFrame;              // The frame a skinned object's tier was last chosen on, or 0
+    std::vector<unsigned> slotOf;           // Each object's handle slot
+
+    std::vector<int> slotIndex;             // The object in each slot, or -1 if the slot is free
+    std::vector<unsigned> slotGeneration;
+    std::vector<unsigned> freeSlots;
+} SceneStore;
+
+// Append an object with every field zero, returning its handle.
+ObjectHandle addSceneObject(SceneStore* store);
+
+// Append a copy of the object at index, returning the copy's handle.
+ObjectHandle copySceneObject(SceneStore* store, int index);
+
+// Remove an object, moving the last object into its index.  Does nothing if
+// the handle is stale.
+void removeSceneObject(SceneStore* store, ObjectHandle handle);
+
+// The object's index, or -1 if the handle is stale (or noObject).
+int objectIndex(const SceneStore& store, ObjectHandle handle);
+
+ObjectHandle objectHandle(const SceneStore& store, int index);
+
+#endif // SCENE_STORE_H
@@ -0,0 +1,379 @@
+#include "shader-cache.h"
+#include "gl-extra.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+
+static ShaderVariant variants[numShaderVariants];
+
+static std::string vSource, fSource;  // Sources as read, without defines
+static std::string cachePath;         // Empty when binaries can't be cached
+static std::string driverString;      // Vendor, renderer and version of the GL
+
+static const unsigned binaryMagic = 0x31425053; // "SPB1"
+
+// Read a whole shader file into a string
+static bool readSource(const char* fileName, std::string& out) {
+    FILE* fp = fopen(fileName, "rb");
+    if(fp == NULL) return false;
+
+    fseek(fp, 0L, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0L, SEEK_SET);
+
+    out.resize(size);
+    size = fread(&out[0], 1, size, fp);
+    out.resize(size);
+    fclose(fp);
+    return true;
+}
+
+// 64-bit FNV-1a, enough to tell shader sources and drivers apart
+static unsigned long long hashString(const std::string& s, unsigned long long h) {
+    for(size_t i=0; i < s.size(); i++) {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static std::string definesFor(unsigned features) {
+    char defines[256];
+    sprintf(defines, "#define VARIANT %u\n%s%s%s%s%s%s", features,
+            features & SHADER_SKINNED ? "#define SKINNED\n" : "",
+            features & SHADER_TEXTURED ? "#define TEXTURED\n" : "",
+            features & SHADER_ALPHA ? "#define ALPHA\n" : "",
+            features & SHADER_BAKED ? "#define BAKED\n" : "",
+            features & SHADER_TWO_BONES ? "#define TWO_BONES\n" : "",
+            features & SHADER_ONE_BONE ? "#define ONE_BONE\n" : "");
+    return defines;
+}
+
+// The #version directive must stay first, so the defines go after that line.
+static std::string withDefines(const std::string& source, const std::string& defines) {
+    size_t eol = source.find('\n');
+    if(source.compare(0, 8, "#version") != 0 || eol == std::string::npos)
+        return defines + source;
+    return source.substr(0, eol+1) + defines + source.substr(eol+1);
+}
+
+static std::string binaryFileName(unsigned features) {
+    unsigned long long h = 14695981039346656037ULL;
+    h = hashString(vSource, h);
+    h = hashString(fSource, h);
+    h = hashString(definesFor(features), h);
+    h = hashString(driverString, h);
+
+    char name[64];
+    sprintf(name, "/%016llx.bin", h);
+    return cachePath + name;
+}
+
+static void printShaderLog(GLuint shader, const char* what, unsigned features) {
+    GLint logSize;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logSize);
+    char* logMsg = new char[logSize+1];
+    logMsg[0] = '\0';
+    glGetShaderInfoLog(shader, logSize, NULL, logMsg);
+    std::cerr << what << " (features 0x" << std::hex << features << std::dec
+              << ") failed to compile:" << std::endl << logMsg << std::endl;
+    delete [] logMsg;
+}
+
+static void checkLinked(GLuint program, unsigned features) {
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if(linked) return;
+
+    // Report the shader logs as well, since compile errors surface here when
+    // compilation ran in the background and was never checked on its own.
+    GLuint shaders[2];
+    GLsizei count = 0;
+    glGetAttachedShaders(program, 2, &count, shaders);
+    for(int i=0; i < count; i++) {
+        GLint compiled;
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+        if(!compiled) printShaderLog(shaders[i], "Shader", features);
+    }
+
+    std::cerr << "Shader program (features 0x" << std::hex << features << std::dec
+              << ") failed to link" << std::endl;
+    GLint logSize;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logSize);
+    char* logMsg = new char[logSize+1];
+    logMsg[0] = '\0';
+    glGetProgramInfoLog(program, logSize, NULL, logMsg);
+    std::cerr << logMsg << std::endl;
+    delete [] logMsg;
+
+    exit(EXIT_FAILURE);
+}
+
+static bool loadBinary(ShaderVariant& v) {
+    if(!glExtHasProgramBinary || cachePath.empty()) return false;
+
+    FILE* fp = fopen(binaryFileName(v.features).c_str(), "rb");
+    if(fp == NULL) return false;
+
+    unsigned magic = 0;
+    GLenum format = 0;
+    GLint length = 0;
+    bool ok = fread(&magic, sizeof magic, 1, fp) == 1 && magic == binaryMagic
+              && fread(&format, sizeof format, 1, fp) == 1
+              && fread(&length, sizeof length, 1, fp) == 1 && length > 0;
+
+    char* binary = ok ? new char[length] : NULL;
+    ok = ok && fread(binary, 1, length, fp) == (size_t) length;
+    fclose(fp);
+
+    if(ok) {
+        glExtProgramBinary(v.program, format, binary, length);
+        GLint linked;
+        glGetProgramiv(v.program, GL_LINK_STATUS, &linked);
+        ok = linked;  // Drivers reject binaries after an update - just rebuild.
+    }
+    delete [] binary;
+    return ok;
+}
+
+static void saveBinary(ShaderVariant& v) {
+    if(!glExtHasProgramBinary || cachePath.empty()) return;
+
+    GLint length = 0;
+    glGetProgramiv(v.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) return;
+
+    char* binary = new char[length];
+    GLenum format = 0;
+    glExtGetProgramBinary(v.program, length, &length, &format, binary);
+
+    // Write to a temporary file first so a crash can't leave a truncated binary.
+    std::string fileName = binaryFileName(v.features);
+    std::string tmpName = fileName + ".tmp";
+    FILE* fp = fopen(tmpName.c_str(), "wb");
+    if(fp != NULL) {
+        bool ok = fwrite(&binaryMagic, sizeof binaryMagic, 1, fp) == 1
+                  && fwrite(&format, sizeof format, 1, fp) == 1
+                  && fwrite(&length, sizeof length, 1, fp) == 1
+                  && fwrite(binary, 1, length, fp) == (size_t) length;
+        ok = fclose(fp) == 0 && ok;
+        if(ok) rename(tmpName.c_str(), fileName.c_str());
+        else remove(tmpName.c_str());
+    }
+    delete [] binary;
+}
+
+static void getUniformLocations(ShaderVariant& v) {
+    GLuint p = v.program;
+    v.projectionU = glGetUniformLocation(p, "Projection");
+    v.viewU = glGetUniformLocation(p, "View");
+    v.modelViewU = glGetUniformLocation(p, "ModelView");
+    v.bonePalettesU = glGetUniformLocation(p, "BonePalettes");
+    v.paletteBaseU = glGetUniformLocation(p, "PaletteBase");
+    v.textureU = glGetUniformLocation(p, "texture");
+    v.texScaleU = glGetUniformLocation(p, "texScale");
+    v.materialColorU = glGetUniformLocation(p, "MaterialColor");
+    v.ambientU = glGetUniformLocation(p, "Ambient");
+    v.diffuseU = glGetUniformLocation(p, "Diffuse");
+    v.specularU = glGetUniformLocation(p, "Specular");
+    v.shininessU = glGetUniformLocation(p, "Shininess");
+    v.alphaU = glGetUniformLocation(p, "Alpha");
+    v.lightDataU = glGetUniformLocation(p, "LightData");
+    v.clusterGridU = glGetUniformLocation(p, "ClusterGrid");
+    v.lightIndicesU = glGetUniformLocation(p, "LightIndices");
+    v.numDirLightsU = glGetUniformLocation(p, "NumDirLights");
+    v.clusterDimsU = glGetUniformLocation(p, "ClusterDims");
+    v.clusterDepthU = glGetUniformLocation(p, "ClusterDepth");
+    v.screenSizeU = glGetUniformLocation(p, "ScreenSize");
+    v.ambientLightU = glGetUniformLocation(p, "AmbientLight");
+    v.bakedPosesU = glGetUniformLocation(p, "BakedPoses");
+    v.instanceDataU = glGetUniformLocation(p, "InstanceData");
+    v.bakedSizeU = glGetUniformLocation(p, "BakedSize");
+    v.bakedSampleRateU = glGetUniformLocation(p, "BakedSampleRate");
+    v.firstInstanceU = glGetUniformLocation(p, "FirstInstance");
+}
+
+static GLuint compileShader(GLenum type, const std::string& source) {
+    GLuint shader = glCreateShader(type);
+    const GLchar* src = source.c_str();
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+static void bindAttribLocations(GLuint program) {
+    glBindAttribLocation(program, ATTRIB_POSITION, "vPosition");
+    glBindAttribLocation(program, ATTRIB_NORMAL, "vNormal");
+    glBindAttribLocation(program, ATTRIB_TEXCOORD, "vTexCoord");
+    glBindAttribLocation(program, ATTRIB_BONE_IDS, "vBoneIDs");
+    glBindAttribLocation(program, ATTRIB_BONE_WEIGHTS, "vBoneWeights");
+}
+
+// Compile and link, without querying the result so that a driver with
+// parallel compilation can carry on in the background.
+static void startBuild(ShaderVariant& v) {
+    std::string defines = definesFor(v.features);
+    GLuint vs = compileShader(GL_VERTEX_SHADER, withDefines(vSource, defines));
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, withDefines(fSource, defines));
+    glAttachShader(v.program, vs);
+    glAttachShader(v.program, fs);
+
+    bindAttribLocations(v.program);
+    glBindFragDataLocation(v.program, 0, "fColor");
+
+    if(glExtHasProgramBinary)
+        glExtProgramParameteri(v.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    glLinkProgram(v.program);
+    v.pending = true;
+}
+
+static void completeBuild(ShaderVariant& v) {
+    checkLinked(v.program, v.features);
+
+    GLuint shaders[2];
+    GLsizei count = 0;
+    glGetAttachedShaders(v.program, 2, &count, shaders);
+    for(int i=0; i < count; i++) {
+        glDetachShader(v.program, shaders[i]);
+        glDeleteShader(shaders[i]);
+    }
+
+    saveBinary(v);
+    getUniformLocations(v);
+    v.pending = false;
+    v.ready = true;
+}
+
+GLuint buildSkinPrepassProgram(unsigned features) {
+    GLuint program = glCreateProgram();
+    GLuint vs = compileShader(GL_VERTEX_SHADER,
+                              withDefines(vSource, definesFor(features) + "#define SKIN_PREPASS\n"));
+    glAttachShader(program, vs);
+    bindAttribLocations(program);
+
+    const GLchar* varyings[2] = { "skinnedPosition", "skinnedNormal" };
+    glTransformFeedbackVaryings(program, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program);
+    checkLinked(program, features);
+
+    glDetachShader(program, vs);
+    glDeleteShader(vs);
+    return program;
+}
+
+void initShaderCache(const char* vShaderFile, const char* fShaderFile, const char* cacheDir) {
+    if(!readSource(vShaderFile, vSource)) {
+        std::cerr << "Failed to read " << vShaderFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if(!readSource(fShaderFile, fSource)) {
+        std::cerr << "Failed to read " << fShaderFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    driverString = std::string((const char*) glGetString(GL_VENDOR)) + "|"
+                   + (const char*) glGetString(GL_RENDERER) + "|"
+                   + (const char*) glGetString(GL_VERSION);
+
+    // Without a writable directory we still work, just without binaries.
+    cachePath = cacheDir;
+    mkdir(cacheDir, 0755);
+    struct stat st;
+    if(stat(cacheDir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        std::cerr << "Shader cache directory " << cacheDir << " is unavailable" << std::endl;
+        cachePath.clear();
+    }
+
+    if(glExtHasParallelCompile)
+        glExtMaxShaderCompilerThreads(0xFFFFFFFF); // Let the driver pick the thread count
+
+    for(unsigned i=0; i < numShaderVariants; i++) {
+        variants[i].features = i;
+        variants[i].program = 0;
+        variants[i].pending = variants[i].ready = false;
+        variants[i].frameStamp = -1;
+    }
+}
+
+void requestShaderVariant(unsigned features) {
+    ShaderVariant& v = variants[features];
+    if(v.program != 0) return;
+
+    v.program = glCreateProgram();
+    if(loadBinary(v)) {
+        getUniformLocations(v);
+        v.ready = true;
+        return;
+    }
+
+    // Without parallel compilation, updateShaderCache builds one queued
+    // variant per frame rather than stalling for all of them at once.
+    if(glExtHasParallelCompile)
+        startBuild(v);
+}
+
+ShaderVariant* finishShaderVariant(unsigned features) {
+    ShaderVariant& v = variants[features];
+    requestShaderVariant(features);
+    if(!v.ready) {
+        if(!v.pending) startBuild(v);
+        completeBuild(v);
+    }
+    return &v;
+}
+
+void updateShaderCache() {
+    bool builtOne = false;
+    for(unsigned i=0; i < numShaderVariants; i++) {
+        ShaderVariant& v = variants[i];
+        if(v.program == 0 || v.ready) continue;
+
+        if(v.pending) {
+            GLint done = GL_TRUE;
+            if(glExtHasParallelCompile)
+                glGetProgramiv(v.program, GL_COMPLETION_STATUS_KHR, &done);
+            if(done) completeBuild(v);
+        } else if(!builtOne) {
+            startBuild(v);
+            completeBuild(v);
+            builtOne = true;
+        }
+    }
+}
+
+bool shaderVariantsPending() {
+    for(unsigned i=0; i < numShaderVariants; i++)
+        if(variants[i].program != 0 && !variants[i].ready)
+            return true;
+    return false;
+}
+
+// A ready variant with a superset of the features, or NULL.  Extra features
+// mustn't change how the vertices are found, only add to what's done with them.
+static ShaderVariant* readySuperset(unsigned features) {
+    if(variants[features].ready)
+        return &variants[features];
+    for(unsigned extra=1; extra <= SHADER_FLAG_MASK; extra++) {
+        if(extra & (SHADER_BAKED | SHADER_REDUCED_BONES)) continue;
+        unsigned f = features | extra;
+        if(f != features && variants[f].ready)
+            return &variants[f];
+    }
+    return NULL;
+}
+
+ShaderVariant* useShaderVariant(unsigned features) {
+    requestShaderVariant(features);
+
+    ShaderVariant* best = readySuperset(features);
+    if(best == NULL && (features & SHADER_REDUCED_BONES))
+        best = readySuperset(features & ~SHADER_REDUCED_BONES);
+    if(best == NULL) return NULL;
+
+    glUseProgram(best->program);
+    return best;
+}
@@ -0,0 +1,87 @@
+// ------ Shader permutation cache --------------------------------------------
+//
+// Programs are built from vStart.glsl and fStart.glsl with a block of
+// #defines chosen by feature bits, so each combination of features gets its
+// own program and the shaders don't branch on them at runtime.
+//
+// Linked programs are written to disk with glGetProgramBinary, keyed by a hash
+// of the sources, the defines and the driver string, so later runs skip
+// compilation.  Where GL_KHR_parallel_shader_compile is available variants
+// compile in the background; until a variant is ready, the nearest ready
+// variant with a superset of its features is used instead.
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "Angel.h"
+
+enum ShaderFeature {
+    SHADER_SKINNED  = 1 << 0, // Blend bones from BonePalettes in the vertex shader (see bone-palettes.h)
+    SHADER_TEXTURED = 1 << 1, // Modulate the colour by the texture
+    SHADER_ALPHA    = 1 << 2, // Output the Alpha uniform rather than 1.0
+    SHADER_BAKED    = 1 << 3, // Instanced, posed from baked palettes (with SKINNED, see anim-bake.h)
+    SHADER_TWO_BONES = 1 << 4, // Skin with the two heaviest bones only (see anim-lod.h)
+    SHADER_ONE_BONE = 1 << 5, // Skin with the heaviest bone only
+};
+
+const unsigned SHADER_FLAG_MASK = 0x3F;
+
+// Features that only save work, and can be dropped to find a ready variant.
+const unsigned SHADER_REDUCED_BONES = SHADER_TWO_BONES | SHADER_ONE_BONE;
+const unsigned numShaderVariants = SHADER_FLAG_MASK + 1;
+
+// Attribute locations are bound before linking so every variant agrees and a
+// mesh's VAO can be drawn with any of them.
+enum {
+    ATTRIB_POSITION = 0,
+    ATTRIB_NORMAL,
+    ATTRIB_TEXCOORD,
+    ATTRIB_BONE_IDS,
+    ATTRIB_BONE_WEIGHTS
+};
+
+typedef struct {
+    unsigned features;
+    GLuint program;    // 0 until the variant has been requested
+    bool pending;      // Compiling in the background
+    bool ready;        // Linked and usable
+    int frameStamp;    // Free for the caller, e.g. to set per-frame uniforms once
+
+    // Uniform locations (-1 when the variant doesn't use the uniform)
+    GLint projectionU, viewU, modelViewU;
+    GLint bonePalettesU, paletteBaseU;  // See bone-palettes.h
+    GLint textureU, texScaleU;
+    GLint materialColorU, ambientU, diffuseU, specularU, shininessU, alphaU;
+    GLint lightDataU, clusterGridU, lightIndicesU, numDirLightsU;  // See lights.h
+    GLint clusterDimsU, clusterDepthU, screenSizeU, ambientLightU;
+    GLint bakedPosesU, instanceDataU, bakedSizeU, bakedSampleRateU, firstInstanceU;  // See anim-bake.h
+} ShaderVariant;
+
+// Read the shader sources and prepare the cache directory (created if needed).
+void initShaderCache(const char* vShaderFile, const char* fShaderFile, const char* cacheDir);
+
+// Start building a variant without waiting for it.
+void requestShaderVariant(unsigned features);
+
+// Build a variant now, blocking until it is linked.
+ShaderVariant* finishShaderVariant(unsigned features);
+
+// Advance background compilation.  Call once per frame.
+void updateShaderCache();
+
+// True while any requested variant is still being built.
+bool shaderVariantsPending();
+
+// Bind the variant for these features, or the nearest ready superset while it
+// is still compiling.  Returns NULL only when no suitable variant is ready.
+// BAKED variants draw differently, so never stand in for others or the reverse.
+// Failing a superset, the variant without SHADER_REDUCED_BONES (or its nearest
+// superset) is used.
+ShaderVariant* useShaderVariant(unsigned features);
+
+// Build a vertex-only program from vStart.glsl with the features' defines and
+// SKIN_PREPASS, capturing skinnedPosition and skinnedNormal, interleaved, with
+// transform feedback (see skin-prepass.h).  Blocks until linked; exits if it fails.
+GLuint buildSkinPrepassProgram(unsigned features);
+
+#endif // SHADER_CACHE_H
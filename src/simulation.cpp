@@ -0,0 +1,169 @@
+#include "simulation.h"
+#include "frame-pacer.h"
+#include "trace.h"
+
+#include <math.h>
+#include <mutex>
+#include <thread>
+
+// Scaling constants, per millisecond of simulated time.
+static const float turnScale = 0.1;
+static const float moveScale = 0.003;
+static const float gravity = 0.00004;
+static const float impulse = 0.01;
+
+static const float stepMs = simStep * 1000.0;
+
+// If the simulation falls this far behind (e.g. the process was stopped, or
+// nothing sampled it for a while) the lost time is dropped rather than run.
+static const double maxCatchUp = 0.25;
+
+static std::mutex simMutex;
+static SimState prevState, currState;
+static double currTime = 0.0;   // When currState applies
+static SimInput input = { false };
+static float pendingYaw = 0.0, pendingPitch = 0.0;
+static bool pendingJump = false;
+static bool threadedSim = false;
+
+static void step(SimState& s) {
+    s.animFrame += 1.0;
+
+    if (!input.gameMode) {
+        pendingYaw = pendingPitch = 0.0;
+        pendingJump = false;
+        return;
+    }
+
+    // High school trig for position deltas (warning: pen and paper required).
+    float sinYaw = sin(s.yaw*0.0174532925), cosYaw = cos(s.yaw*0.0174532925);
+    if (input.runForward) {
+        s.dx -= sinYaw * moveScale * stepMs;
+        s.dz += cosYaw * moveScale * stepMs;
+    }
+    if (input.runBack) {
+        s.dx += sinYaw * moveScale * stepMs;
+        s.dz -= cosYaw * moveScale * stepMs;
+    }
+    if (input.strafeRight) {
+        s.dz -= sinYaw * moveScale * stepMs;
+        s.dx -= cosYaw * moveScale * stepMs;
+    }
+    if (input.strafeLeft) {
+        s.dz += sinYaw * moveScale * stepMs;
+        s.dx += cosYaw * moveScale * stepMs;
+    }
+
+    // s = ut + (1/2)at^2
+    // Luckily we can deal with s' through incremental +=/-= operators.
+    // ds/dt = v = u + at
+    if (pendingJump) {
+        s.jumping = true;
+        pendingJump = false;
+    }
+    if (s.jumping) {
+        s.dy += s.inertia * stepMs;
+        s.inertia -= gravity * stepMs;
+        if (s.dy < 1.5) {
+            s.jumping = false;
+            s.dy = 1.5;
+            s.inertia = impulse;
+        }
+    }
+
+    // Keyboard tilting isn't forgotten for those not using the mouse.
+    s.yaw += pendingYaw - input.yawLeft * turnScale * stepMs + input.yawRight * turnScale * stepMs;
+    s.pitch += pendingPitch - input.pitchUp * turnScale * stepMs + input.pitchDown * turnScale * stepMs;
+    pendingYaw = pendingPitch = 0.0;
+
+    // Limit the pitch to a single hemisphere to avoid nauseating effects of
+    // gimble-lock outside this range (gimble-lock at 90 and -90 is desired though).
+    if (s.pitch > 90) {
+        s.pitch = 90;
+    } else if (s.pitch < -90) {
+        s.pitch = -90;
+    }
+}
+
+// Called with simMutex held.
+static void runDueSteps(double now) {
+    if (now - currTime > maxCatchUp)
+        currTime = now - maxCatchUp;
+
+    while (currTime + simStep <= now) {
+        TraceZone zone("simStep");
+        prevState = currState;
+        step(currState);
+        currTime += simStep;
+    }
+}
+
+static void simThread() {
+    setTraceThreadName("simulation");
+    for (;;) {
+        double next;
+        {
+            std::lock_guard<std::mutex> lock(simMutex);
+            runDueSteps(monotonicSeconds());
+            next = currTime + simStep;
+        }
+        sleepUntilSeconds(next);
+    }
+}
+
+void initSimulation(double startTime, bool threaded) {
+    SimState initial = { 0.0, 0.0, 0.0, 1.5, 0.0, impulse, false, 0.0 };
+    prevState = currState = initial;
+    currTime = startTime;
+
+    // The thread runs until the process exits.
+    threadedSim = threaded;
+    if (threaded)
+        std::thread(simThread).detach();
+}
+
+void setSimInput(const SimInput& newInput) {
+    std::lock_guard<std::mutex> lock(simMutex);
+    input = newInput;
+}
+
+void addSimLook(float yawDegrees, float pitchDegrees) {
+    std::lock_guard<std::mutex> lock(simMutex);
+    pendingYaw += yawDegrees;
+    pendingPitch += pitchDegrees;
+}
+
+void startSimJump() {
+    std::lock_guard<std::mutex> lock(simMutex);
+    pendingJump = true;
+}
+
+bool simInputPending() {
+    std::lock_guard<std::mutex> lock(simMutex);
+    return pendingJump || pendingYaw != 0.0 || pendingPitch != 0.0;
+}
+
+static float lerp(float a, float b, float f) {
+    return a + (b - a) * f;
+}
+
+SimState sampleSimulation(double now) {
+    std::lock_guard<std::mutex> lock(simMutex);
+    if (!threadedSim)
+        runDueSteps(now);
+
+    // currState is for currTime, prevState a step earlier; draw the state for now - simStep.
+    float f = (now - currTime) / simStep;
+    f = f < 0.0 ? 0.0 : (f > 1.0 ? 1.0 : f);
+
+    SimState s;
+    s.yaw = lerp(prevState.yaw, currState.yaw, f);
+    s.pitch = lerp(prevState.pitch, currState.pitch, f);
+    s.dx = lerp(prevState.dx, currState.dx, f);
+    s.dy = lerp(prevState.dy, currState.dy, f);
+    s.dz = lerp(prevState.dz, currState.dz, f);
+    s.inertia = lerp(prevState.inertia, currState.inertia, f);
+    s.jumping = currState.jumping;
+    s.animFrame = lerp(prevState.animFrame, currState.animFrame, f);
+    return s;
+}
@@ -0,0 +1,51 @@
+// ------ Fixed-timestep simulation -------------------------------------------
+//
+// Game-mode movement, jumping and the animation clock advance in fixed steps
+// of simStep seconds, so they behave the same at any frame rate.  The last two
+// states are kept and the renderer draws the state interpolated between them
+// for the current time, which is up to one step behind.
+//
+// Steps normally run on the main thread when the renderer samples the state.
+// With initSimulation(true) they run on their own thread instead, and the
+// input and state are handed over under a lock.
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+const double simStep = 1.0 / 60.0;  // Seconds per step
+
+typedef struct {
+    float yaw, pitch;   // Head rotation, degrees
+    float dx, dy, dz;   // Position: variation from the origin
+    float inertia;      // Upwards speed while jumping
+    bool jumping;
+    float animFrame;    // Animation clock, in steps
+} SimState;
+
+// Keys currently held down.  Only used while gameMode is set.
+typedef struct {
+    bool gameMode;
+    bool runForward, runBack, strafeLeft, strafeRight;
+    bool yawLeft, yawRight, pitchUp, pitchDown;
+} SimInput;
+
+// Start the simulation at the given monotonicSeconds() time, optionally on
+// its own thread.
+void initSimulation(double startTime, bool threaded);
+
+// Replace the held keys.  Takes effect from the next step.
+void setSimInput(const SimInput& input);
+
+// Mouse look and jumping are events rather than held keys, so they're queued
+// for the next step.
+void addSimLook(float yawDegrees, float pitchDegrees);
+void startSimJump();
+
+// True while queued look or jump events haven't been stepped yet.
+bool simInputPending();
+
+// Run any steps that are due (unless threaded) and return the state
+// interpolated for the given monotonicSeconds() time.
+SimState sampleSimulation(double now);
+
+#endif // SIMULATION_H
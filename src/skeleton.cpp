@@ -0,0 +1,326 @@
+#include "skeleton.h"
+#include "clip-compress.h"
+
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace std;
+
+static mat4 toMat4(const aiMatrix4x4& m) {
+    return mat4(vec4(m.a1, m.a2, m.a3, m.a4),
+                vec4(m.b1, m.b2, m.b3, m.b4),
+                vec4(m.c1, m.c2, m.c3, m.c4),
+                vec4(m.d1, m.d2, m.d3, m.d4));
+}
+
+// Preorder, so parents come before their children.  Where names repeat, the
+// first node keeps the name, as with FindNode.
+static void addNodes(const aiNode* node, int parent, Skeleton* skeleton, map<string, int>* byName) {
+    int index = skeleton->parent.size();
+    skeleton->parent.push_back(parent);
+    skeleton->restLocal.push_back(toMat4(node->mTransformation));
+    byName->insert(make_pair(string(node->mName.data), index));
+
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+        addNodes(node->mChildren[i], index, skeleton, byName);
+}
+
+static int findNode(const map<string, int>& byName, const aiString& name) {
+    map<string, int>::const_iterator found = byName.find(string(name.data));
+    return found == byName.end() ? -1 : found->second;
+}
+
+// Where keys are interpolated linearly, as calculateAnimPose does, to resample them.
+static aiVector3D sampleKeys(const aiVectorKey* keys, unsigned int numKeys, double time,
+                             const aiVector3D& none) {
+    if (numKeys == 0) return none;
+    unsigned int i = 0;
+    while (i + 1 < numKeys && keys[i + 1].mTime <= time) i++;
+    if (i + 1 == numKeys) return keys[i].mValue;
+    float weight1 = (time - keys[i].mTime) / (keys[i + 1].mTime - keys[i].mTime);
+    return keys[i].mValue * (1.0f - weight1) + keys[i + 1].mValue * weight1;
+}
+
+static aiQuaternion sampleKeys(const aiQuatKey* keys, unsigned int numKeys, double time) {
+    if (numKeys == 0) return aiQuaternion();
+    unsigned int i = 0;
+    while (i + 1 < numKeys && keys[i + 1].mTime <= time) i++;
+    if (i + 1 == numKeys) return keys[i].mValue;
+    float weight1 = (time - keys[i].mTime) / (keys[i + 1].mTime - keys[i].mTime);
+    aiQuaternion q;
+    aiQuaternion::Interpolate(q, keys[i].mValue, keys[i + 1].mValue, weight1);
+    return q.Normalize();
+}
+
+// Smallest gap between consecutive keys, or 0 if there are none.
+template <typename Key>
+static double smallestGap(const Key* keys, unsigned int numKeys, double smallest) {
+    for (unsigned int i = 0; i + 1 < numKeys; i++) {
+        double gap = keys[i + 1].mTime - keys[i].mTime;
+        if (gap > 1e-6 && (smallest == 0.0 || gap < smallest)) smallest = gap;
+    }
+    return smallest;
+}
+
+template <typename Key>
+static double lastKeyTime(const Key* keys, unsigned int numKeys, double last) {
+    return numKeys > 0 && keys[numKeys - 1].mTime > last ? keys[numKeys - 1].mTime : last;
+}
+
+static long greatestCommonDivisor(long a, long b) {
+    while (b != 0) {
+        long r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// Key times are compared in thousandths of a tick.
+static const double tickParts = 1000.0;
+
+// Fold a time into the greatest common divisor of the times so far, in
+// thousandths of a tick, or give -1 once any time falls between them.
+static long tickDivisor(double time, long divisor) {
+    double parts = floor(time * tickParts + 0.5);
+    if (divisor < 0 || fabs(time * tickParts - parts) > 1e-3) return -1;
+    return greatestCommonDivisor(divisor, labs((long) parts));
+}
+
+template <typename Key>
+static long tickDivisor(const Key* keys, unsigned int numKeys, long divisor) {
+    for (unsigned int i = 0; i < numKeys; i++)
+        divisor = tickDivisor(keys[i].mTime, divisor);
+    return divisor;
+}
+
+static SkeletonClip compileClip(const aiAnimation* anim, const map<string, int>& byName) {
+    SkeletonClip clip;
+    clip.compressed = false;
+    double gap = 0.0, end = anim->mDuration;
+    long divisor = 0;
+    for (unsigned int c = 0; c < anim->mNumChannels; c++) {
+        const aiNodeAnim* ch = anim->mChannels[c];
+        gap = smallestGap(ch->mPositionKeys, ch->mNumPositionKeys, gap);
+        gap = smallestGap(ch->mRotationKeys, ch->mNumRotationKeys, gap);
+        gap = smallestGap(ch->mScalingKeys, ch->mNumScalingKeys, gap);
+        end = lastKeyTime(ch->mPositionKeys, ch->mNumPositionKeys, end);
+        end = lastKeyTime(ch->mRotationKeys, ch->mNumRotationKeys, end);
+        end = lastKeyTime(ch->mScalingKeys, ch->mNumScalingKeys, end);
+        divisor = tickDivisor(ch->mPositionKeys, ch->mNumPositionKeys, divisor);
+        divisor = tickDivisor(ch->mRotationKeys, ch->mNumRotationKeys, divisor);
+        divisor = tickDivisor(ch->mScalingKeys, ch->mNumScalingKeys, divisor);
+    }
+    divisor = tickDivisor(end, divisor);
+
+    if (gap == 0.0 || end <= 0.0) {  // Nothing moves
+        clip.step = 1.0;
+        clip.numSamples = 1;
+    } else {
+        // Every key and the end lie on the step, or failing that, the end does.
+        double step = divisor > 0 ? divisor / tickParts : end / ceil(end / gap - 1e-4);
+        clip.numSamples = (int) floor(end / step + 0.5) + 1;
+        if (clip.numSamples > maxClipSamples) {
+            clip.numSamples = maxClipSamples;
+            step = end / (maxClipSamples - 1);
+        }
+        clip.step = step;
+    }
+
+    for (unsigned int c = 0; c < anim->mNumChannels; c++) {
+        const aiNodeAnim* ch = anim->mChannels[c];
+        clip.channelNode.push_back(findNode(byName, ch->mNodeName));
+        for (int k = 0; k < clip.numSamples; k++) {
+            double time = k * (double) clip.step;
+            aiVector3D p = sampleKeys(ch->mPositionKeys, ch->mNumPositionKeys, time, aiVector3D(0.0, 0.0, 0.0));
+            aiQuaternion r = sampleKeys(ch->mRotationKeys, ch->mNumRotationKeys, time);
+            aiVector3D s = sampleKeys(ch->mScalingKeys, ch->mNumScalingKeys, time, aiVector3D(1.0, 1.0, 1.0));
+            clip.positions.push_back(vec3(p.x, p.y, p.z));
+            clip.rotations.push_back(vec4(r.x, r.y, r.z, r.w));
+            clip.scales.push_back(vec3(s.x, s.y, s.z));
+        }
+    }
+    return clip;
+}
+
+// At least the largest factor a transformation scales lengths by, even when
+// sheared: the Frobenius norm of its upper 3x3.
+static float largestScale(const mat4& m) {
+    float sum = 0.0f;
+    for (int i = 0; i < 3; i++)
+        sum += dot(vec3(m[i][0], m[i][1], m[i][2]), vec3(m[i][0], m[i][1], m[i][2]));
+    return sqrt(sum);
+}
+
+void findClipBounds(Skeleton* skeleton, const aiMesh* mesh) {
+    int numVertices = mesh->mNumVertices, numBones = mesh->mNumBones;
+    skeleton->restBounds = emptyBounds();
+    for (int v = 0; v < numVertices; v++)
+        addPoint(&skeleton->restBounds, vec3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z));
+    if (numBones == 0) {
+        for (size_t a = 0; a < skeleton->clips.size(); a++)
+            skeleton->clips[a].bounds = skeleton->restBounds;
+        return;
+    }
+
+    // The sphere round the vertices each bone moves (radius -1 if none).
+    vector<vec3> centre(numBones);
+    vector<float> radius(numBones, -1.0f);
+    vector<int> influences(numVertices, 0);
+    vector<float> weightSum(numVertices, 0.0f);
+    for (int b = 0; b < numBones; b++) {
+        const aiBone* bone = mesh->mBones[b];
+        Bounds box = emptyBounds();
+        for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+            const aiVector3D& p = mesh->mVertices[bone->mWeights[w].mVertexId];
+            addPoint(&box, vec3(p.x, p.y, p.z));
+            influences[bone->mWeights[w].mVertexId]++;
+            weightSum[bone->mWeights[w].mVertexId] += bone->mWeights[w].mWeight;
+        }
+        if (bone->mNumWeights == 0) continue;
+        centre[b] = boundsCentre(box);
+        radius[b] = 0.0f;
+        for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+            const aiVector3D& p = mesh->mVertices[bone->mWeights[w].mVertexId];
+            radius[b] = max(radius[b], length(vec3(p.x, p.y, p.z) - centre[b]));
+        }
+    }
+
+    // Only four bones per vertex are used, so more also leaves weight missing.
+    bool towardsOrigin = false;
+    for (int v = 0; v < numVertices; v++)
+        towardsOrigin = towardsOrigin || influences[v] > 4 || fabs(weightSum[v] - 1.0f) > 1e-3f;
+
+    vector<mat4> palette(numBones);
+    vector<vec3> last(numBones);
+    PoseScratch scratch;
+    for (size_t a = 0; a < skeleton->clips.size(); a++) {
+        SkeletonClip& clip = skeleton->clips[a];
+        Bounds bounds = emptyBounds();
+        float furthestStep = 0.0f;
+        for (int k = 0; k < clip.numSamples; k++) {
+            calculateSkeletonPose(skeleton, a, k * clip.step, &scratch, &palette[0]);
+            for (int b = 0; b < numBones; b++) {
+                if (radius[b] < 0.0f) continue;
+                vec4 c = palette[b] * vec4(centre[b], 1.0);
+                vec3 moved(c.x, c.y, c.z);
+                addSphere(&bounds, moved, radius[b] * largestScale(palette[b]));
+                if (k > 0) furthestStep = max(furthestStep, length(moved - last[b]));
+                last[b] = moved;
+            }
+        }
+        if (bounds.low.x > bounds.high.x) bounds = skeleton->restBounds; // No bone moves any vertex
+        addSphere(&bounds, bounds.low, furthestStep / 2.0f);
+        addSphere(&bounds, bounds.high, furthestStep / 2.0f);
+        if (towardsOrigin) addPoint(&bounds, vec3(0.0, 0.0, 0.0));
+        clip.bounds = bounds;
+    }
+}
+
+Skeleton* compileSkeleton(const aiScene* scene, const aiMesh* mesh) {
+    Skeleton* skeleton = new Skeleton();
+    map<string, int> byName;
+    addNodes(scene->mRootNode, -1, skeleton, &byName);
+
+    for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+        const aiBone* bone = mesh->mBones[b];
+        skeleton->boneNode.push_back(findNode(byName, bone->mName));
+        skeleton->boneOffset.push_back(toMat4(bone->mOffsetMatrix));
+    }
+
+    for (unsigned int a = 0; a < scene->mNumAnimations; a++)
+        skeleton->clips.push_back(compileClip(scene->mAnimations[a], byName));
+    findClipBounds(skeleton, mesh);
+    return skeleton;
+}
+
+// As aiQuaternion::Interpolate, followed by normalising.
+static vec4 slerp(const vec4& a, const vec4& b, float weight1) {
+    float cosom = dot(a, b);
+    vec4 end = cosom < 0.0f ? -b : b;  // The shorter way round
+    cosom = fabs(cosom);
+
+    float sclp = 1.0f - weight1, sclq = weight1;
+    if (1.0f - cosom > 0.0001f) {
+        float omega = acos(cosom), sinom = sin(omega);
+        sclp = sin((1.0f - weight1) * omega) / sinom;
+        sclq = sin(weight1 * omega) / sinom;
+    }
+    vec4 q = sclp * a + sclq * end;
+    return q / length(q);
+}
+
+// Translation, then rotation, then scale (the matrix aiQuaternion::GetMatrix gives, scaled).
+static mat4 localTransform(const vec3& p, const vec4& q, const vec3& s) {
+    float x = q.x, y = q.y, z = q.z, w = q.w;
+    return mat4(vec4((1.0f - 2.0f*(y*y + z*z)) * s.x, 2.0f*(x*y - z*w) * s.y, 2.0f*(x*z + y*w) * s.z, p.x),
+                vec4(2.0f*(x*y + z*w) * s.x, (1.0f - 2.0f*(x*x + z*z)) * s.y, 2.0f*(y*z - x*w) * s.z, p.y),
+                vec4(2.0f*(x*z - y*w) * s.x, 2.0f*(y*z + x*w) * s.y, (1.0f - 2.0f*(x*x + y*y)) * s.z, p.z),
+                vec4(0.0, 0.0, 0.0, 1.0));
+}
+
+// A compressed channel's transformation at the given sample (see clip-compress.h).
+static mat4 compressedTransform(const SkeletonClip& clip, int channel, float at) {
+    vec4 p0, p1, q0, q1, s0, s1;
+    float pw, qw, sw;
+    findCompressedKeys(clip, 3 * channel, at, &p0, &p1, &pw);
+    findCompressedKeys(clip, 3 * channel + 1, at, &q0, &q1, &qw);
+    findCompressedKeys(clip, 3 * channel + 2, at, &s0, &s1, &sw);
+    vec4 p = p0 * (1.0f - pw) + p1 * pw, s = s0 * (1.0f - sw) + s1 * sw;
+    return localTransform(vec3(p.x, p.y, p.z), slerp(q0, q1, qw), vec3(s.x, s.y, s.z));
+}
+
+void calculateSkeletonPose(const Skeleton* skeleton, int animNum, float poseTime,
+                           PoseScratch* scratch, mat4* boneTransforms) {
+    int numBones = skeleton->boneNode.size();
+    if (numBones == 0 || animNum < 0) {
+        boneTransforms[0] = mat4(1.0);
+        return;
+    }
+    if ((int) skeleton->clips.size() <= animNum) {
+        fprintf(stderr, "No animation with number: %d\n", animNum);
+        exit(1);
+    }
+
+    const SkeletonClip& clip = skeleton->clips[animNum];
+    vector<mat4>& local = scratch->local;
+    vector<mat4>& global = scratch->global;
+    global.resize(skeleton->parent.size());
+
+    // The samples either side of poseTime, the same for every channel.
+    float at = max(0.0f, poseTime / clip.step);
+    int k = min((int) at, clip.numSamples - 1);
+    int next = min(k + 1, clip.numSamples - 1);
+    float weight1 = k == next ? 0.0f : at - k;
+
+    local = skeleton->restLocal;
+    for (size_t c = 0; c < clip.channelNode.size(); c++) {
+        if (clip.channelNode[c] < 0) continue;
+        if (clip.compressed) {
+            local[clip.channelNode[c]] = compressedTransform(clip, c, min(at, (float) (clip.numSamples - 1)));
+            continue;
+        }
+        int i = c * clip.numSamples + k, j = c * clip.numSamples + next;
+        local[clip.channelNode[c]] = localTransform(
+            clip.positions[i] * (1.0f - weight1) + clip.positions[j] * weight1,
+            slerp(clip.rotations[i], clip.rotations[j], weight1),
+            clip.scales[i] * (1.0f - weight1) + clip.scales[j] * weight1);
+    }
+
+    // Parents come first, so each node's parent is already done.
+    for (size_t n = 0; n < local.size(); n++) {
+        int parent = skeleton->parent[n];
+        global[n] = parent < 0 ? local[n] : global[parent] * local[n];
+    }
+
+    for (int b = 0; b < numBones; b++) {
+        int node = skeleton->boneNode[b];
+        boneTransforms[b] = node < 0 ? skeleton->boneOffset[b] : global[node] * skeleton->boneOffset[b];
+    }
+}
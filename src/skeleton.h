@@ -0,0 +1,104 @@
+// ------ Compiled skeletons ------------------------------------------------------
+//
+// calculateAnimPose in gnatidread2.h finds each animated node and each bone by
+// searching the node tree by name, on every call, then multiplies its way up
+// from every bone to the root.  A Skeleton does those searches once, when the
+// mesh is loaded: the nodes are flattened into arrays with each parent before
+// its children, and each animation channel and bone keeps the index of its
+// node.  A pose is then one pass over the nodes, parents first, plus one
+// product per bone.
+//
+// Finding the keys either side of a time also took a scan from the first key.
+// Instead, each clip's channels are resampled when it's compiled, at one fixed
+// step for the whole clip, so the samples either side of a time are found by
+// a division, once per pose.  The step is the greatest common divisor of the
+// key times (to a thousandth of a tick), so every key and the end of the clip
+// fall on a sample, and the result is exactly what the keys give:
+// interpolating between samples follows the same lines and arcs as between
+// the keys.  Keys at odder times, or too many samples, give a step stretched
+// so the last sample falls on the end, and a result only near the keys'.
+// Scaling keys are kept too, which calculateAnimPose leaves out.
+//
+// Posing only reads the skeleton, unlike calculateAnimPose, which leaves each
+// pose in the scene's nodes.  The working space belongs to the caller, so any
+// number of threads can pose the same skeleton at once, each with its own.
+
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include "Angel.h"
+#include "bounds.h"
+
+#include <vector>
+
+struct aiScene;
+struct aiMesh;
+
+// The keys kept from one channel's positions, rotations or scales, once compressed.
+typedef struct {
+    int firstKey, numKeys;                 // Into keySamples, and keyValues in threes
+    vec3 low, extent;                      // The range positions and scales are quantised over
+} CompressedTrack;
+
+// Samples for channel c are at [c*numSamples, (c+1)*numSamples).
+typedef struct {
+    float step;                            // Ticks between samples
+    int numSamples;                        // Covering [0, duration]
+    std::vector<int> channelNode;          // The node each channel moves, or -1
+    std::vector<vec3> positions;
+    std::vector<vec4> rotations;           // Quaternions, as (x, y, z, w)
+    std::vector<vec3> scales;
+
+    // When compressed, these replace the samples (see clip-compress.h).
+    bool compressed;
+    std::vector<CompressedTrack> tracks;   // Position, rotation and scale for each channel
+    std::vector<unsigned short> keySamples; // The sample each kept key was taken from
+    std::vector<unsigned short> keyValues; // Three for each key, quantised
+
+    Bounds bounds;                         // The skinned mesh, in every pose of the clip
+} SkeletonClip;
+
+typedef struct {
+    // The nodes, parents first.
+    std::vector<int> parent;               // -1 for the root
+    std::vector<mat4> restLocal;           // Relative to the parent, unanimated
+
+    // The bones, in the mesh's order (the order of the shader's bone IDs).
+    std::vector<int> boneNode;
+    std::vector<mat4> boneOffset;          // From the mesh to the bone at rest
+
+    std::vector<SkeletonClip> clips;       // One for each of the scene's animations
+    Bounds restBounds;                     // The mesh as it is, unskinned
+} Skeleton;
+
+// Working space for calculateSkeletonPose, sized as needed.
+typedef struct {
+    std::vector<mat4> local, global;       // Each node's transformation
+} PoseScratch;
+
+// Most samples kept per channel; longer clips are sampled more coarsely.
+const int maxClipSamples = 4096;
+
+// Flatten the scene's node tree, look up the mesh's bones and the animations'
+// channels in it, and resample the channels.  The scene isn't needed afterwards.
+//
+// Each clip's bounds are found by posing it at every sample.  The vertices
+// each bone moves are wrapped in a sphere, and the box takes in every bone's
+// sphere as the bone carries it: a skinned vertex is a blend of its bones'
+// copies of it, so it stays inside.  The box is then grown by half the
+// furthest any sphere moves from one sample to the next, for the poses
+// between samples.  Vertices whose weights don't add up to one are drawn
+// towards the origin, so then the origin is taken in too.
+Skeleton* compileSkeleton(const aiScene* scene, const aiMesh* mesh);
+
+// Find the clips' bounds again, as compileSkeleton does.  Compressing a clip
+// (see clip-compress.h) moves its poses, so its bounds need finding again after.
+void findClipBounds(Skeleton* skeleton, const aiMesh* mesh);
+
+// As calculateAnimPose: fill boneTransforms with a transformation for each
+// bone relative to the rest pose, or with one identity matrix if the mesh has
+// no bones or animNum is -1.  Exits if there's no animation animNum.
+void calculateSkeletonPose(const Skeleton* skeleton, int animNum, float poseTime,
+                           PoseScratch* scratch, mat4* boneTransforms);
+
+#endif // SKELETON_H
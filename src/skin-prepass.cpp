@@ -0,0 +1,111 @@
+#include "skin-prepass.h"
+#include "bone-palettes.h"
+#include "shader-cache.h"
+#include "trace.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A buffer of skinned vertices, and the VAO that draws it.
+typedef struct {
+    GLuint buffer, vao;
+    GLsizeiptr capacity;        // Bytes
+    GLuint vertexBuffer;        // The mesh the VAO was last pointed at, or 0
+    GLuint elementBuffer;
+} SkinnedSlot;
+
+// A program for each animation tier, skinning with its number of bones.
+static const int numTiers = ANIM_LOD_QUARTER + 1;
+static GLuint programs[numTiers];
+static GLint paletteBaseU[numTiers];
+
+static vector<SkinnedSlot> slots;
+static size_t slotsUsed;                 // This frame
+static map<pair<int, int>, GLuint> skinned; // Palette bases and tiers applied this frame, and their VAOs
+
+static const int skinnedVertexFloats = 6; // Position, then normal
+
+void initSkinPrepass() {
+    for (int lod = 0; lod < numTiers; lod++) {
+        programs[lod] = buildSkinPrepassProgram(SHADER_SKINNED | animLodShaderFeatures((AnimLod) lod));
+        paletteBaseU[lod] = glGetUniformLocation(programs[lod], "PaletteBase");
+        glUseProgram(programs[lod]);
+        glUniform1i(glGetUniformLocation(programs[lod], "BonePalettes"), bonePaletteUnit);
+    }
+    glUseProgram(0);
+    CheckError();
+}
+
+// Point a slot's VAO at a mesh, with room for its skinned vertices.
+static void prepareSlot(SkinnedSlot& slot, const PrepassMesh& mesh) {
+    if (slot.vao == 0) {
+        glGenVertexArrays(1, &slot.vao);
+        glGenBuffers(1, &slot.buffer);
+    }
+
+    GLsizeiptr bytes = sizeof(GLfloat) * skinnedVertexFloats * mesh.numVertices;
+    if (slot.capacity < bytes) {
+        glBindBuffer(GL_ARRAY_BUFFER, slot.buffer);
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_COPY);
+        slot.capacity = bytes;
+    }
+
+    if (slot.vertexBuffer == mesh.vertexBuffer && slot.elementBuffer == mesh.elementBuffer)
+        return;
+    slot.vertexBuffer = mesh.vertexBuffer;
+    slot.elementBuffer = mesh.elementBuffer;
+
+    GLsizei stride = sizeof(GLfloat) * skinnedVertexFloats;
+    glBindVertexArray(slot.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, slot.buffer);
+    glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(ATTRIB_NORMAL);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glVertexAttribPointer(ATTRIB_TEXCOORD, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(mesh.texCoordOffset));
+    glEnableVertexAttribArray(ATTRIB_TEXCOORD);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.elementBuffer);
+    glBindVertexArray(0);
+}
+
+void beginSkinPrepass() {
+    slotsUsed = 0;
+    skinned.clear();
+    glEnable(GL_RASTERIZER_DISCARD);
+}
+
+GLuint skinPrepass(const PrepassMesh& mesh, int paletteBase, AnimLod lod) {
+    map<pair<int, int>, GLuint>::iterator found = skinned.find(make_pair(paletteBase, (int) lod));
+    if (found != skinned.end())
+        return found->second;
+
+    TraceZone zone("skinPrepass");
+    if (slotsUsed == slots.size()) {
+        SkinnedSlot empty = { 0, 0, 0, 0, 0 };
+        slots.push_back(empty);
+    }
+    SkinnedSlot& slot = slots[slotsUsed++];
+    prepareSlot(slot, mesh);
+
+    glUseProgram(programs[lod]);
+    glUniform1i(paletteBaseU[lod], paletteBase);
+    glBindVertexArray(mesh.vao);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, slot.buffer);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, mesh.numVertices);
+    glEndTransformFeedback();
+    CheckError();
+
+    skinned[make_pair(paletteBase, (int) lod)] = slot.vao;
+    return slot.vao;
+}
+
+void endSkinPrepass() {
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+}
@@ -0,0 +1,54 @@
+// ------ Skinning pre-pass -----------------------------------------------------
+//
+// The SKINNED shader variants skin every vertex in every draw, so a posed mesh
+// drawn more than once a frame (instances sharing a pose from the pose cache,
+// or any later extra pass) repeats the same blending each time.  With the
+// pre-pass, each distinct palette is applied to its mesh once, before any
+// drawing: vStart.glsl, built vertex-only with SKIN_PREPASS (see
+// buildSkinPrepassProgram in shader-cache.h), skins the mesh's vertices as
+// points with rasterisation off, and transform feedback captures the skinned
+// positions and normals into a buffer of their own.  Each of these buffers has
+// a VAO that reads positions and normals from it, and texture coordinates and
+// indices from the mesh, so the object is then drawn by the static
+// (unskinned) variants like any other mesh.  There's a program for each
+// animation tier, blending the tier's number of bones (see anim-lod.h).
+//
+// Results are told apart by the tier and the palette's base in the frame's
+// palette buffer (see bone-palettes.h), which is distinct for each mesh, clip
+// and pose time during a frame, and the pre-pass reads its bones from there
+// too.  The buffers and VAOs are kept from frame to frame and handed out again
+// in order, growing as needed.
+
+#ifndef SKIN_PREPASS_H
+#define SKIN_PREPASS_H
+
+#include "Angel.h"
+#include "anim-lod.h"
+
+// Where a mesh's vertex data lives, as uploadMesh lays it out.
+typedef struct {
+    GLuint vao;              // The mesh's own, with its bone IDs and weights
+    GLuint vertexBuffer;     // Holding the texture coordinates...
+    GLintptr texCoordOffset; // ...from this offset, three floats per vertex
+    GLuint elementBuffer;
+    int numVertices;
+} PrepassMesh;
+
+// Build the transform feedback programs.  Needs a current GL context, after
+// initShaderCache.
+void initSkinPrepass();
+
+// Start the frame's pre-pass: forget last frame's palettes, and turn
+// rasterisation off until endSkinPrepass.  The frame's
+// palettes must already be uploaded and bound.
+void beginSkinPrepass();
+
+// Skin a mesh with the palette starting at paletteBase and the tier's bones,
+// unless that has already been done this frame, and return the VAO to draw
+// the result with.
+GLuint skinPrepass(const PrepassMesh& mesh, int paletteBase, AnimLod lod);
+
+// Turn rasterisation back on.  The caller binds its own program next.
+void endSkinPrepass();
+
+#endif // SKIN_PREPASS_H
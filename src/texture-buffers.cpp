@@ -0,0 +1,22 @@
+#include "texture-buffers.h"
+
+GLuint createBufferTexture(GLuint buffer, GLenum format) {
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_BUFFER, tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return tex;
+}
+
+void appendMatrixRows(const mat4& m, std::vector<vec4>* texels) {
+    texels->push_back(m[0]);
+    texels->push_back(m[1]);
+    texels->push_back(m[2]);
+}
+
+void streamTexels(GLuint buffer, const std::vector<vec4>& texels) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(vec4), &texels[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
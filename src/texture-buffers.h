@@ -0,0 +1,25 @@
+// ------ Texture buffers -------------------------------------------------------
+//
+// The lights, baked clips, instance data and bone palettes all reach the
+// shaders through texture buffers.  Matrices go in as their top three rows,
+// three RGBA32F texels each, since the bottom row of a bone or model matrix is
+// always (0, 0, 0, 1); the shaders rebuild it.
+
+#ifndef TEXTURE_BUFFERS_H
+#define TEXTURE_BUFFERS_H
+
+#include "Angel.h"
+
+#include <vector>
+
+// A buffer texture reading buffer as texels of the given format.
+GLuint createBufferTexture(GLuint buffer, GLenum format);
+
+// Append the top three rows of m.
+void appendMatrixRows(const mat4& m, std::vector<vec4>* texels);
+
+// Replace a buffer's contents for this frame.  Last frame's store is orphaned
+// rather than waited on by draws still reading it.
+void streamTexels(GLuint buffer, const std::vector<vec4>& texels);
+
+#endif // TEXTURE_BUFFERS_H
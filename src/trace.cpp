@@ -0,0 +1,136 @@
+#include "trace.h"
+
+#include <mutex>
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+std::atomic<bool> traceEnabled(false);
+
+typedef struct {
+    const char* name;
+    long long start, end;
+} TraceEvent;
+
+const int traceBufferEvents = 1 << 16;
+
+// One per thread that has recorded anything.  Only the owning thread writes
+// events; count is published with release ordering so writeTrace can read
+// the events below it while the thread carries on.
+struct TraceBuffer {
+    int tid;
+    const char* threadName;
+    std::atomic<unsigned> generation;  // The tracing session the events belong to
+    std::atomic<int> count;
+    std::atomic<int> dropped;
+    TraceEvent events[traceBufferEvents];
+};
+
+static std::mutex buffersMutex;           // Guards buffers, only when threads first record
+static std::vector<TraceBuffer*> buffers;
+static std::atomic<unsigned> generation(0);
+static long long sessionStart = 0;
+
+static thread_local TraceBuffer* threadBuffer = NULL;
+static thread_local const char* pendingThreadName = NULL;
+
+long long traceNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec + 1;
+}
+
+// Buffers are never freed: threads are never joined, and a thread that has
+// finished may still have events to write.
+static TraceBuffer* bufferForThisThread() {
+    if (threadBuffer == NULL) {
+        threadBuffer = new TraceBuffer();
+        threadBuffer->threadName = pendingThreadName;
+        threadBuffer->generation = generation.load();
+        threadBuffer->count = 0;
+        threadBuffer->dropped = 0;
+
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        threadBuffer->tid = buffers.size() + 1;
+        buffers.push_back(threadBuffer);
+    }
+
+    // A new session: the owner clears its own buffer, so no other thread has to.
+    unsigned current = generation.load(std::memory_order_acquire);
+    if (threadBuffer->generation.load(std::memory_order_relaxed) != current) {
+        threadBuffer->count.store(0, std::memory_order_relaxed);
+        threadBuffer->dropped.store(0, std::memory_order_relaxed);
+        threadBuffer->generation.store(current, std::memory_order_release);
+    }
+    return threadBuffer;
+}
+
+void addTraceZone(const char* name, long long start, long long end) {
+    TraceBuffer* buffer = bufferForThisThread();
+    int n = buffer->count.load(std::memory_order_relaxed);
+    if (n == traceBufferEvents) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events[n].name = name;
+    buffer->events[n].start = start;
+    buffer->events[n].end = end;
+    buffer->count.store(n + 1, std::memory_order_release);
+}
+
+void setTracing(bool on) {
+    if (on && !traceEnabled.load()) {
+        sessionStart = traceNow();
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    traceEnabled.store(on);
+}
+
+void setTraceThreadName(const char* name) {
+    pendingThreadName = name;
+    if (threadBuffer != NULL)
+        threadBuffer->threadName = name;
+}
+
+bool writeTrace(const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL)
+        return false;
+
+    std::vector<TraceBuffer*> current;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        current = buffers;
+    }
+
+    unsigned session = generation.load(std::memory_order_acquire);
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    int dropped = 0;
+    for (size_t b = 0; b < current.size(); b++) {
+        TraceBuffer* buffer = current[b];
+        if (buffer->generation.load(std::memory_order_acquire) != session)
+            continue;  // Nothing recorded this session
+
+        char defaultName[32];
+        snprintf(defaultName, sizeof defaultName, "thread %d", buffer->tid);
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", buffer->tid, buffer->threadName ? buffer->threadName : defaultName);
+        first = false;
+
+        int n = buffer->count.load(std::memory_order_acquire);
+        for (int i = 0; i < n; i++) {
+            const TraceEvent& e = buffer->events[i];
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    e.name, buffer->tid, (e.start - sessionStart) / 1000.0, (e.end - e.start) / 1000.0);
+        }
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    fprintf(fp, "\n]}\n");
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    if (dropped > 0)
+        printf("Trace buffers filled up: %d zones were dropped\n", dropped);
+    return ok;
+}
@@ -0,0 +1,49 @@
+// ------ Trace recorder ----------------------------------------------------------
+//
+// Records where time goes as nested zones on each thread, and writes them in
+// the Chrome trace event format (chrome://tracing or ui.perfetto.dev).  Mark a
+// zone with a TraceZone for the duration of a scope:
+//
+//     TraceZone zone("loadMesh");
+//
+// Zone names must be string literals, or otherwise live for the whole run.
+// Each thread appends to its own fixed-size buffer without locking; a full
+// buffer drops further zones.  While tracing is off a zone costs one relaxed
+// atomic load.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+
+extern std::atomic<bool> traceEnabled;
+
+// Nanoseconds on the monotonic clock.  Never 0.
+long long traceNow();
+
+// Record a finished zone on the calling thread.
+void addTraceZone(const char* name, long long start, long long end);
+
+// Turning tracing on discards anything recorded before.
+void setTracing(bool on);
+
+// Name the calling thread in the trace (e.g. "main", "worker 2").
+void setTraceThreadName(const char* name);
+
+// Write everything recorded since tracing was last turned on.  Returns false
+// if the file can't be written.
+bool writeTrace(const char* filename);
+
+class TraceZone {
+public:
+    TraceZone(const char* name)
+        : name(name), start(traceEnabled.load(std::memory_order_relaxed) ? traceNow() : 0) {}
+    ~TraceZone() {
+        if (start != 0) addTraceZone(name, start, traceNow());
+    }
+private:
+    const char* name;
+    long long start;  // 0 when tracing was off at the start of the zone
+};
+
+#endif // TRACE_H
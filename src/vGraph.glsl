@@ -0,0 +1,14 @@
+#version 150
+
+in vec2 vPixel;   // Window coordinates, from the bottom-left corner
+in vec3 vColor;
+
+out vec3 color;
+
+uniform vec2 ScreenSize;
+
+void main()
+{
+    gl_Position = vec4(vPixel / ScreenSize * 2.0 - 1.0, 0.0, 1.0);
+    color = vColor;
+}
@@ -1,31 +1,100 @@
 #version 150
 
+// Feature defines (VARIANT, SKINNED, ...) are inserted after the #version line by shader-cache.cpp.
+
 in vec4 vPosition;
 in vec3 vNormal;
 in vec2 vTexCoord;
+#ifdef SKINNED
 in ivec4 vBoneIDs;
 in vec4 vBoneWeights;
+#endif
 
+#ifdef SKIN_PREPASS
+out vec3 skinnedPosition;           // In the mesh's coordinates, captured by transform feedback (see skin-prepass.h)
+out vec3 skinnedNormal;
+#else
 out vec2 texCoord;
 out vec3 N;
 out vec3 pos;
+#endif
 
+#ifndef BAKED
 uniform mat4 ModelView;
+#endif
 uniform mat4 Projection;
-uniform mat4 BoneTransforms[64];
+#ifdef BAKED
+uniform mat4 View;
+uniform samplerBuffer BakedPoses;   // Top three rows of each bone's matrix, palette by palette
+uniform samplerBuffer InstanceData; // Top three rows of the model matrix, then the pose time
+uniform ivec2 BakedSize;            // Bones per palette, palettes
+uniform float BakedSampleRate;      // Palettes per tick
+uniform int FirstInstance;
+#elif defined(SKINNED)
+uniform samplerBuffer BonePalettes; // Top three rows of each bone's matrix, for every palette this frame
+uniform int PaletteBase;            // This draw's first matrix
+#endif
+
+#if defined(SKINNED) || defined(BAKED)
+// Rows are fetched into columns, hence the transpose.
+mat4 fetchMatrix(samplerBuffer buffer, int texel)
+{
+    return transpose(mat4(texelFetch(buffer, texel), texelFetch(buffer, texel+1),
+                          texelFetch(buffer, texel+2), vec4(0.0, 0.0, 0.0, 1.0)));
+}
+#endif
+
+#ifdef BAKED
+// A bone's matrix at the instance's pose time, blended between the baked palettes either side.
+mat4 bakedBone(int bone, int palette0, int palette1, float weight1)
+{
+    return fetchMatrix(BakedPoses, 3 * (palette0 * BakedSize.x + bone)) * (1.0 - weight1) +
+           fetchMatrix(BakedPoses, 3 * (palette1 * BakedSize.x + bone)) * weight1;
+}
+#endif
 
 void main()
 {
-    // Calculate bone tranformation
-    mat4 boneTransform = vBoneWeights[0] * BoneTransforms[vBoneIDs[0]] +
-                         vBoneWeights[1] * BoneTransforms[vBoneIDs[1]] +
-                         vBoneWeights[2] * BoneTransforms[vBoneIDs[2]] +
-                         vBoneWeights[3] * BoneTransforms[vBoneIDs[3]];
+#ifdef BAKED
+    int instance = 4 * (FirstInstance + gl_InstanceID);
+    mat4 ModelView = View * fetchMatrix(InstanceData, instance);
+
+    float at = clamp(texelFetch(InstanceData, instance+3).x * BakedSampleRate, 0.0, float(BakedSize.y - 1));
+    int palette0 = int(at), palette1 = min(palette0 + 1, BakedSize.y - 1);
+    float weight1 = at - float(palette0);
+
+    #define BONE(i) bakedBone(vBoneIDs[i], palette0, palette1, weight1)
+#elif defined(SKINNED)
+    #define BONE(i) fetchMatrix(BonePalettes, 3 * (PaletteBase + vBoneIDs[i]))
+#endif
+
+#ifdef SKINNED
+    // Calculate bone tranformation.  The weights are sorted heaviest first, so
+    // fewer bones means the heaviest ones, renormalised.
+#if defined(ONE_BONE)
+    mat4 boneTransform = BONE(0);
+#elif defined(TWO_BONES)
+    mat4 boneTransform = (vBoneWeights[0] * BONE(0) + vBoneWeights[1] * BONE(1)) /
+                         (vBoneWeights[0] + vBoneWeights[1]);
+#else
+    mat4 boneTransform = vBoneWeights[0] * BONE(0) +
+                         vBoneWeights[1] * BONE(1) +
+                         vBoneWeights[2] * BONE(2) +
+                         vBoneWeights[3] * BONE(3);
+#endif
 
     // Transform position and normal with bone transform
     vec4 tPosition = boneTransform * vPosition;
     vec3 tNormal = (boneTransform * vec4(vNormal, 0.0)).xyz;
-    
+#else
+    vec4 tPosition = vPosition;
+    vec3 tNormal = vNormal;
+#endif
+
+#ifdef SKIN_PREPASS
+    skinnedPosition = tPosition.xyz;
+    skinnedNormal = tNormal;
+#else
     // Transform vertex position into eye coordinates
     pos = (ModelView * tPosition).xyz;
 
@@ -34,4 +103,5 @@ void main()
 
     gl_Position = Projection * ModelView * tPosition;
     texCoord = vTexCoord;
+#endif
 }